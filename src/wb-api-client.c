@@ -0,0 +1,669 @@
+/*
+ *  Weibird - View and compose weibo
+ *  Copyright (C) 2019 Jonathan Kang <jonathankang@gnome.org>.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gio/gio.h>
+#include <json-glib/json-glib.h>
+#include <rest/oauth2-proxy.h>
+
+#include "wb-api-client.h"
+#include "wb-application.h"
+#include "wb-comment.h"
+#include "wb-entity-store.h"
+#include "wb-tweet-item.h"
+
+struct _WbApiClient
+{
+    GObject parent_instance;
+};
+
+typedef struct
+{
+    gchar *access_token;
+    gchar *app_key;
+    GSettings *settings;
+    RestProxy *proxy;
+} WbApiClientPrivate;
+
+/* Builds the result of a call out of the returned JSON data. Runs in
+ * a worker thread. */
+typedef gpointer (*WbApiBuildFunc) (JsonNode *root_node);
+
+typedef struct
+{
+    RestProxyCall *call;
+    GError *error;
+    WbApiBuildFunc build_func;
+    GDestroyNotify result_free_func;
+} WbApiCallData;
+
+G_DEFINE_TYPE_WITH_PRIVATE (WbApiClient, wb_api_client, G_TYPE_OBJECT)
+
+static const gchar SETTINGS_SCHEMA[] = "com.jonathankang.Weibird";
+static const gchar ACCESS_TOKEN[] = "access-token";
+static const gchar APP_KEY[] = "app-key";
+
+static void
+wb_api_client_reset_proxy (WbApiClient *self)
+{
+    WbApiClientPrivate *priv = wb_api_client_get_instance_private (self);
+
+    g_free (priv->access_token);
+    g_free (priv->app_key);
+    g_clear_object (&priv->proxy);
+
+    /* Read from the settings "changed" is connected to, so that the
+     * key has been read and the signal is emitted. */
+    priv->access_token = g_settings_get_string (priv->settings, ACCESS_TOKEN);
+    priv->app_key = g_settings_get_string (priv->settings, APP_KEY);
+
+    /* Keep a single proxy around, so that the underlying soup session
+     * and its connections are reused by every call. */
+    priv->proxy = oauth2_proxy_new_with_token (priv->app_key,
+                                               priv->access_token,
+                                               "https://api.weibo.com/oauth2/authorize",
+                                               "https://api.weibo.com", FALSE);
+}
+
+static void
+settings_changed_cb (GSettings *settings,
+                     const gchar *key,
+                     gpointer user_data)
+{
+    WbApiClient *self = WB_API_CLIENT (user_data);
+
+    if (g_strcmp0 (key, ACCESS_TOKEN) == 0 ||
+        g_strcmp0 (key, APP_KEY) == 0)
+    {
+        wb_api_client_reset_proxy (self);
+    }
+}
+
+static RestProxyCall *
+wb_api_client_new_call (WbApiClient *self,
+                        const gchar *function,
+                        const gchar *method)
+{
+    RestProxyCall *call;
+    WbApiClientPrivate *priv = wb_api_client_get_instance_private (self);
+
+    call = rest_proxy_new_call (priv->proxy);
+    rest_proxy_call_set_function (call, function);
+    rest_proxy_call_set_method (call, method);
+    rest_proxy_call_add_param (call, "access_token", priv->access_token);
+
+    return call;
+}
+
+static void
+wb_api_call_data_free (WbApiCallData *data)
+{
+    g_object_unref (data->call);
+    g_clear_error (&data->error);
+
+    g_slice_free (WbApiCallData, data);
+}
+
+static void
+parse_thread (GTask *task,
+              gpointer source_object,
+              gpointer task_data,
+              GCancellable *cancellable)
+{
+    const gchar *function;
+    const gchar *payload;
+    goffset payload_length;
+    GError *parser_error = NULL;
+    JsonNode *root_node;
+    JsonParser *parser;
+    WbApiCallData *data = task_data;
+
+    function = rest_proxy_call_get_function (data->call);
+
+    payload = rest_proxy_call_get_payload (data->call);
+    payload_length = rest_proxy_call_get_payload_length (data->call);
+
+    parser = json_parser_new ();
+    if (payload == NULL ||
+        !json_parser_load_from_data (parser, payload,
+                                     payload_length, &parser_error))
+    {
+        if (data->error != NULL)
+        {
+            g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                     "Error calling Weibo API(%s): %s",
+                                     function, data->error->message);
+        }
+        else if (parser_error != NULL)
+        {
+            g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                     "Failed to parse data of Weibo API(%s): %s",
+                                     function, parser_error->message);
+        }
+        else
+        {
+            g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                     "Weibo API(%s) returned no data",
+                                     function);
+        }
+
+        g_clear_error (&parser_error);
+        g_object_unref (parser);
+
+        return;
+    }
+
+    root_node = json_parser_get_root (parser);
+    if (data->error != NULL)
+    {
+        /* Weibo API describes what went wrong in the payload. */
+        if (JSON_NODE_HOLDS_OBJECT (root_node))
+        {
+            JsonObject *object;
+
+            object = json_node_get_object (root_node);
+
+            g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                     "Failed to send request: %s (%" G_GINT64_FORMAT ", %s)",
+                                     json_object_get_string_member (object, "request"),
+                                     json_object_get_int_member (object, "error_code"),
+                                     json_object_get_string_member (object, "error"));
+        }
+        else
+        {
+            g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                     "Error calling Weibo API(%s): %s",
+                                     function, data->error->message);
+        }
+    }
+    else if (data->build_func != NULL)
+    {
+        g_task_return_pointer (task, data->build_func (root_node),
+                               data->result_free_func);
+    }
+    else
+    {
+        g_task_return_pointer (task, json_node_copy (root_node),
+                               (GDestroyNotify) json_node_unref);
+    }
+
+    g_object_unref (parser);
+}
+
+static void
+call_finished_cb (RestProxyCall *call,
+                  const GError *error,
+                  GObject *weak_object,
+                  gpointer user_data)
+{
+    GTask *task;
+    WbApiCallData *data;
+
+    task = G_TASK (user_data);
+    data = g_task_get_task_data (task);
+
+    if (error != NULL)
+    {
+        data->error = g_error_copy (error);
+    }
+
+    /* A page of posts is large, don't block the UI while parsing it. */
+    g_task_run_in_thread (task, parse_thread);
+
+    g_object_unref (task);
+}
+
+static gpointer
+build_tweet_items (JsonNode *root_node)
+{
+    guint i;
+    GPtrArray *items;
+
+    items = g_ptr_array_new_with_free_func (g_object_unref);
+
+    if (JSON_NODE_HOLDS_OBJECT (root_node))
+    {
+        JsonObject *object;
+
+        object = json_node_get_object (root_node);
+
+        if (json_object_has_member (object, "statuses"))
+        {
+            JsonArray *array;
+
+            array = json_object_get_array_member (object, "statuses");
+            for (i = 0; i < json_array_get_length (array); i++)
+            {
+                JsonNode *node;
+                WbTweetItem *tweet_item;
+
+                /* Kept as text, to be recorded if the post is shown.
+                 * The JSON nodes belong to this thread. */
+                node = json_array_get_element (array, i);
+                tweet_item = wb_tweet_item_new (json_node_get_object (node));
+                tweet_item->json = json_to_string (node, FALSE);
+                g_ptr_array_add (items, tweet_item);
+            }
+        }
+    }
+
+    return items;
+}
+
+static gpointer
+build_comments (JsonNode *root_node)
+{
+    guint i;
+    GPtrArray *comments;
+
+    comments = g_ptr_array_new_with_free_func (g_object_unref);
+
+    if (JSON_NODE_HOLDS_OBJECT (root_node))
+    {
+        JsonObject *object;
+
+        object = json_node_get_object (root_node);
+
+        if (json_object_has_member (object, "comments"))
+        {
+            JsonArray *array;
+
+            /* Sorted by descending time (new to old). */
+            array = json_object_get_array_member (object, "comments");
+            for (i = 0; i < json_array_get_length (array); i++)
+            {
+                JsonNode *node;
+                WbComment *comment;
+
+                node = json_array_get_element (array, i);
+                comment = wb_comment_new (json_node_get_object (node));
+                comment->json = json_to_string (node, FALSE);
+                g_ptr_array_add (comments, comment);
+            }
+        }
+    }
+
+    return comments;
+}
+
+/* Cancelling @cancellable doesn't abort the HTTP request, but the result
+ * will be discarded and the callback gets G_IO_ERROR_CANCELLED. */
+static void
+wb_api_client_invoke (WbApiClient *self,
+                      RestProxyCall *call,
+                      WbApiBuildFunc build_func,
+                      GDestroyNotify result_free_func,
+                      GCancellable *cancellable,
+                      GAsyncReadyCallback callback,
+                      gpointer user_data,
+                      gpointer source_tag)
+{
+    GError *error = NULL;
+    GTask *task;
+    WbApiCallData *data;
+
+    data = g_slice_new0 (WbApiCallData);
+    data->call = g_object_ref (call);
+    data->build_func = build_func;
+    data->result_free_func = result_free_func;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_source_tag (task, source_tag);
+    g_task_set_task_data (task, data, (GDestroyNotify) wb_api_call_data_free);
+
+    if (!rest_proxy_call_async (call, call_finished_cb, NULL, task, &error))
+    {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+    }
+}
+
+static gpointer
+wb_api_client_finish (WbApiClient *self,
+                      GAsyncResult *result,
+                      gpointer source_tag,
+                      GError **error)
+{
+    g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+    g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == source_tag,
+                          NULL);
+
+    return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/**
+ * wb_api_client_get_home_timeline_async:
+ * @self: a #WbApiClient
+ * @since_id: (nullable): only fetch posts newer than this id
+ * @max_id: (nullable): only fetch posts older than or equal to this id
+ * @count: number of posts to fetch, at most 100, or 0 for the default
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: callback to call when the request is finished
+ * @user_data: data to pass to @callback
+ *
+ * Call 2/statuses/home_timeline asynchronously.
+ */
+void
+wb_api_client_get_home_timeline_async (WbApiClient *self,
+                                       const gchar *since_id,
+                                       const gchar *max_id,
+                                       gint count,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data)
+{
+    RestProxyCall *call;
+
+    g_return_if_fail (WB_IS_API_CLIENT (self));
+    g_return_if_fail (count >= 0 && count <= 100);
+
+    call = wb_api_client_new_call (self, "2/statuses/home_timeline.json", "GET");
+    if (since_id != NULL)
+    {
+        rest_proxy_call_add_param (call, "since_id", since_id);
+    }
+    if (max_id != NULL)
+    {
+        rest_proxy_call_add_param (call, "max_id", max_id);
+    }
+    if (count != 0)
+    {
+        gchar *count_str;
+
+        count_str = g_strdup_printf ("%d", count);
+        rest_proxy_call_add_param (call, "count", count_str);
+        g_free (count_str);
+    }
+
+    wb_api_client_invoke (self, call, build_tweet_items,
+                          (GDestroyNotify) g_ptr_array_unref,
+                          cancellable, callback, user_data,
+                          wb_api_client_get_home_timeline_async);
+
+    g_object_unref (call);
+}
+
+/**
+ * wb_api_client_get_home_timeline_finish:
+ * @self: a #WbApiClient
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError
+ *
+ * The posts are parsed in a worker thread.
+ *
+ * Returns: (transfer full) (element-type WbTweetItem): the posts, newest
+ * first, or %NULL on error
+ */
+GPtrArray *
+wb_api_client_get_home_timeline_finish (WbApiClient *self,
+                                        GAsyncResult *result,
+                                        GError **error)
+{
+    guint i;
+    GPtrArray *items;
+    WbEntityStore *store;
+
+    items = wb_api_client_finish (self, result,
+                                  wb_api_client_get_home_timeline_async, error);
+    if (items == NULL)
+    {
+        return NULL;
+    }
+
+    /* Posts already shown elsewhere are the same objects. */
+    store = wb_application_get_entity_store (WB_APPLICATION (g_application_get_default ()));
+    for (i = 0; i < items->len; i++)
+    {
+        WbTweetItem *tweet_item = g_ptr_array_index (items, i);
+
+        items->pdata[i] = wb_entity_store_intern_status (store, tweet_item);
+        g_object_unref (tweet_item);
+    }
+
+    return items;
+}
+
+/**
+ * wb_api_client_get_comments_async:
+ * @self: a #WbApiClient
+ * @id: id of the post
+ * @max_id: (nullable): only fetch comments older than or equal to this id
+ * @count: number of comments to fetch, at most 200, or 0 for the default
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: callback to call when the request is finished
+ * @user_data: data to pass to @callback
+ *
+ * Call 2/comments/show asynchronously.
+ */
+void
+wb_api_client_get_comments_async (WbApiClient *self,
+                                  const gchar *id,
+                                  const gchar *max_id,
+                                  gint count,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data)
+{
+    RestProxyCall *call;
+
+    g_return_if_fail (WB_IS_API_CLIENT (self));
+    g_return_if_fail (id != NULL);
+    g_return_if_fail (count >= 0 && count <= 200);
+
+    call = wb_api_client_new_call (self, "2/comments/show.json", "GET");
+    rest_proxy_call_add_param (call, "id", id);
+    if (max_id != NULL)
+    {
+        rest_proxy_call_add_param (call, "max_id", max_id);
+    }
+    if (count != 0)
+    {
+        gchar *count_str;
+
+        count_str = g_strdup_printf ("%d", count);
+        rest_proxy_call_add_param (call, "count", count_str);
+        g_free (count_str);
+    }
+
+    wb_api_client_invoke (self, call, build_comments,
+                          (GDestroyNotify) g_ptr_array_unref,
+                          cancellable, callback, user_data,
+                          wb_api_client_get_comments_async);
+
+    g_object_unref (call);
+}
+
+/**
+ * wb_api_client_get_comments_finish:
+ * @self: a #WbApiClient
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError
+ *
+ * The comments are parsed in a worker thread.
+ *
+ * Returns: (transfer full) (element-type WbComment): the comments, newest
+ * first, or %NULL on error
+ */
+GPtrArray *
+wb_api_client_get_comments_finish (WbApiClient *self,
+                                   GAsyncResult *result,
+                                   GError **error)
+{
+    guint i;
+    GPtrArray *comments;
+    WbEntityStore *store;
+
+    comments = wb_api_client_finish (self, result,
+                                     wb_api_client_get_comments_async, error);
+    if (comments == NULL)
+    {
+        return NULL;
+    }
+
+    store = wb_application_get_entity_store (WB_APPLICATION (g_application_get_default ()));
+    for (i = 0; i < comments->len; i++)
+    {
+        wb_entity_store_intern_comment (store,
+                                        g_ptr_array_index (comments, i));
+    }
+
+    return comments;
+}
+
+/**
+ * wb_api_client_create_comment_async:
+ * @self: a #WbApiClient
+ * @id: id of the post to comment on
+ * @comment: the comment text
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: callback to call when the request is finished
+ * @user_data: data to pass to @callback
+ *
+ * Call 2/comments/create asynchronously.
+ */
+void
+wb_api_client_create_comment_async (WbApiClient *self,
+                                    const gchar *id,
+                                    const gchar *comment,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data)
+{
+    RestProxyCall *call;
+
+    g_return_if_fail (WB_IS_API_CLIENT (self));
+    g_return_if_fail (id != NULL);
+    g_return_if_fail (comment != NULL);
+
+    call = wb_api_client_new_call (self, "2/comments/create.json", "POST");
+    rest_proxy_call_add_param (call, "id", id);
+    rest_proxy_call_add_param (call, "comment", comment);
+
+    wb_api_client_invoke (self, call, NULL, NULL, cancellable, callback,
+                          user_data, wb_api_client_create_comment_async);
+
+    g_object_unref (call);
+}
+
+JsonNode *
+wb_api_client_create_comment_finish (WbApiClient *self,
+                                     GAsyncResult *result,
+                                     GError **error)
+{
+    return wb_api_client_finish (self, result,
+                                 wb_api_client_create_comment_async, error);
+}
+
+/**
+ * wb_api_client_reply_comment_async:
+ * @self: a #WbApiClient
+ * @id: id of the post the comment belongs to
+ * @cid: id of the comment to reply to
+ * @comment: the reply text
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: callback to call when the request is finished
+ * @user_data: data to pass to @callback
+ *
+ * Call 2/comments/reply asynchronously.
+ */
+void
+wb_api_client_reply_comment_async (WbApiClient *self,
+                                   const gchar *id,
+                                   const gchar *cid,
+                                   const gchar *comment,
+                                   GCancellable *cancellable,
+                                   GAsyncReadyCallback callback,
+                                   gpointer user_data)
+{
+    RestProxyCall *call;
+
+    g_return_if_fail (WB_IS_API_CLIENT (self));
+    g_return_if_fail (id != NULL);
+    g_return_if_fail (cid != NULL);
+    g_return_if_fail (comment != NULL);
+
+    call = wb_api_client_new_call (self, "2/comments/reply.json", "POST");
+    rest_proxy_call_add_param (call, "id", id);
+    rest_proxy_call_add_param (call, "cid", cid);
+    rest_proxy_call_add_param (call, "comment", comment);
+
+    wb_api_client_invoke (self, call, NULL, NULL, cancellable, callback,
+                          user_data, wb_api_client_reply_comment_async);
+
+    g_object_unref (call);
+}
+
+JsonNode *
+wb_api_client_reply_comment_finish (WbApiClient *self,
+                                    GAsyncResult *result,
+                                    GError **error)
+{
+    return wb_api_client_finish (self, result,
+                                 wb_api_client_reply_comment_async, error);
+}
+
+static void
+wb_api_client_finalize (GObject *object)
+{
+    WbApiClient *self = WB_API_CLIENT (object);
+    WbApiClientPrivate *priv = wb_api_client_get_instance_private (self);
+
+    g_free (priv->access_token);
+    g_free (priv->app_key);
+    g_object_unref (priv->settings);
+    g_clear_object (&priv->proxy);
+
+    G_OBJECT_CLASS (wb_api_client_parent_class)->finalize (object);
+}
+
+static void
+wb_api_client_class_init (WbApiClientClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->finalize = wb_api_client_finalize;
+}
+
+static void
+wb_api_client_init (WbApiClient *self)
+{
+    WbApiClientPrivate *priv = wb_api_client_get_instance_private (self);
+
+    priv->access_token = NULL;
+    priv->app_key = NULL;
+    priv->proxy = NULL;
+
+    /* Credentials are cached in memory, refresh them after logging in. */
+    priv->settings = g_settings_new (SETTINGS_SCHEMA);
+    g_signal_connect (priv->settings, "changed",
+                      G_CALLBACK (settings_changed_cb), self);
+
+    wb_api_client_reset_proxy (self);
+}
+
+/**
+ * wb_api_client_new:
+ *
+ * Create a new #WbApiClient.
+ *
+ * Returns: (transfer full): a newly created #WbApiClient
+ */
+WbApiClient *
+wb_api_client_new (void)
+{
+    return g_object_new (WB_TYPE_API_CLIENT, NULL);
+}
@@ -0,0 +1,72 @@
+/*
+ *  Weibird - View and compose weibo
+ *  Copyright (C) 2019 Jonathan Kang <jonathankang@gnome.org>.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <glib-object.h>
+#include <json-glib/json-glib.h>
+
+G_BEGIN_DECLS
+
+#define WB_TYPE_API_CLIENT (wb_api_client_get_type ())
+
+G_DECLARE_FINAL_TYPE (WbApiClient, wb_api_client, WB, API_CLIENT, GObject)
+
+void wb_api_client_get_home_timeline_async (WbApiClient *self,
+                                            const gchar *since_id,
+                                            const gchar *max_id,
+                                            gint count,
+                                            GCancellable *cancellable,
+                                            GAsyncReadyCallback callback,
+                                            gpointer user_data);
+GPtrArray *wb_api_client_get_home_timeline_finish (WbApiClient *self,
+                                                   GAsyncResult *result,
+                                                   GError **error);
+void wb_api_client_get_comments_async (WbApiClient *self,
+                                       const gchar *id,
+                                       const gchar *max_id,
+                                       gint count,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data);
+GPtrArray *wb_api_client_get_comments_finish (WbApiClient *self,
+                                              GAsyncResult *result,
+                                              GError **error);
+void wb_api_client_create_comment_async (WbApiClient *self,
+                                         const gchar *id,
+                                         const gchar *comment,
+                                         GCancellable *cancellable,
+                                         GAsyncReadyCallback callback,
+                                         gpointer user_data);
+JsonNode *wb_api_client_create_comment_finish (WbApiClient *self,
+                                               GAsyncResult *result,
+                                               GError **error);
+void wb_api_client_reply_comment_async (WbApiClient *self,
+                                        const gchar *id,
+                                        const gchar *cid,
+                                        const gchar *comment,
+                                        GCancellable *cancellable,
+                                        GAsyncReadyCallback callback,
+                                        gpointer user_data);
+JsonNode *wb_api_client_reply_comment_finish (WbApiClient *self,
+                                              GAsyncResult *result,
+                                              GError **error);
+WbApiClient *wb_api_client_new (void);
+
+G_END_DECLS
@@ -19,6 +19,7 @@
 #include <gtk/gtk.h>
 
 #include "config.h"
+#include "wb-api-client.h"
 #include "wb-application.h"
 #include "wb-window.h"
 #include "wb-util.h"
@@ -27,10 +28,80 @@ struct _WbApplication
 {
     /*< private >*/
     GtkApplication parent_instance;
+
+    WbApiClient *api_client;
+    WbImageLoader *image_loader;
+    WbEntityStore *entity_store;
+    WbStore *store;
 };
 
 G_DEFINE_TYPE (WbApplication, wb_application, GTK_TYPE_APPLICATION)
 
+/**
+ * wb_application_get_api_client:
+ * @application: a #WbApplication
+ *
+ * Get the #WbApiClient shared by the whole application.
+ *
+ * Returns: (transfer none): a #WbApiClient
+ */
+WbApiClient *
+wb_application_get_api_client (WbApplication *application)
+{
+    g_return_val_if_fail (WB_IS_APPLICATION (application), NULL);
+
+    return application->api_client;
+}
+
+/**
+ * wb_application_get_image_loader:
+ * @application: a #WbApplication
+ *
+ * Get the #WbImageLoader which schedules all the image downloads.
+ *
+ * Returns: (transfer none): a #WbImageLoader
+ */
+WbImageLoader *
+wb_application_get_image_loader (WbApplication *application)
+{
+    g_return_val_if_fail (WB_IS_APPLICATION (application), NULL);
+
+    return application->image_loader;
+}
+
+/**
+ * wb_application_get_entity_store:
+ * @application: a #WbApplication
+ *
+ * Get the #WbEntityStore which keeps a single copy of every user and
+ * post in use.
+ *
+ * Returns: (transfer none): a #WbEntityStore
+ */
+WbEntityStore *
+wb_application_get_entity_store (WbApplication *application)
+{
+    g_return_val_if_fail (WB_IS_APPLICATION (application), NULL);
+
+    return application->entity_store;
+}
+
+/**
+ * wb_application_get_store:
+ * @application: a #WbApplication
+ *
+ * Get the #WbStore which records posts, users and comments on disk.
+ *
+ * Returns: (transfer none): a #WbStore
+ */
+WbStore *
+wb_application_get_store (WbApplication *application)
+{
+    g_return_val_if_fail (WB_IS_APPLICATION (application), NULL);
+
+    return application->store;
+}
+
 static void
 on_about (GSimpleAction *action,
           GVariant *variant,
@@ -89,6 +160,8 @@ wb_application_activate (GApplication *application)
 static void
 wb_application_startup (GApplication *application)
 {
+    const gchar *refresh_accels[] = { "F5", "<Primary>r", NULL };
+
     g_action_map_add_action_entries (G_ACTION_MAP (application), actions,
                                      G_N_ELEMENTS (actions), application);
 
@@ -97,12 +170,42 @@ wb_application_startup (GApplication *application)
 
     gtk_window_set_default_icon_name ("com.jonathankang.Weibird");
 
+    gtk_application_set_accels_for_action (GTK_APPLICATION (application),
+                                           "win.refresh", refresh_accels);
+
     wb_util_init_soup_session ();
+
+    WB_APPLICATION (application)->api_client = wb_api_client_new ();
+    WB_APPLICATION (application)->image_loader = wb_image_loader_new ();
+    WB_APPLICATION (application)->entity_store = wb_entity_store_new ();
+    WB_APPLICATION (application)->store = wb_store_new ();
+}
+
+static void
+wb_application_shutdown (GApplication *application)
+{
+    WbApplication *self = WB_APPLICATION (application);
+
+    G_APPLICATION_CLASS (wb_application_parent_class)->shutdown (application);
+
+    g_clear_object (&self->api_client);
+    g_clear_object (&self->image_loader);
+    g_clear_object (&self->entity_store);
+    /* Waits for the pending writes. */
+    g_clear_object (&self->store);
+
+    /* Also reached when the last window is closed without using the
+     * quit action. */
+    wb_util_finalize_soup_session ();
 }
 
 static void
 wb_application_init (WbApplication *application)
 {
+    application->api_client = NULL;
+    application->image_loader = NULL;
+    application->entity_store = NULL;
+    application->store = NULL;
 }
 
 static void
@@ -112,6 +215,7 @@ wb_application_class_init (WbApplicationClass *klass)
 
     app_class = G_APPLICATION_CLASS (klass);
     app_class->activate = wb_application_activate;
+    app_class->shutdown = wb_application_shutdown;
     app_class->startup = wb_application_startup;
 }
 
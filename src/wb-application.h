@@ -21,11 +21,20 @@
 
 #include <gtk/gtk.h>
 
+#include "wb-api-client.h"
+#include "wb-entity-store.h"
+#include "wb-image-loader.h"
+#include "wb-store.h"
+
 G_BEGIN_DECLS
 
 #define WB_TYPE_APPLICATION (wb_application_get_type ())
 G_DECLARE_FINAL_TYPE (WbApplication, wb_application, WB, APPLICATION, GtkApplication)
 
+WbApiClient *wb_application_get_api_client (WbApplication *application);
+WbImageLoader *wb_application_get_image_loader (WbApplication *application);
+WbEntityStore *wb_application_get_entity_store (WbApplication *application);
+WbStore *wb_application_get_store (WbApplication *application);
 GtkApplication *wb_application_new (void);
 
 G_END_DECLS
@@ -20,9 +20,10 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gio/gio.h>
 #include <gtk/gtk.h>
-#include <libsoup/soup.h>
 
+#include "wb-application.h"
 #include "wb-avatar-widget.h"
+#include "wb-image-loader.h"
 #include "wb-util.h"
 
 struct _WbAvatarWidget
@@ -35,65 +36,138 @@ typedef struct
     cairo_surface_t *surface;
     gint width;
     gint height;
-    GdkPixbuf *pixbuf;
-    GdkPixbuf *scaled_pixbuf;
     GdkWindow *event_window;
+    WbLazyImage lazy_image;
+    WbUser *user;
 } WbAvatarWidgetPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (WbAvatarWidget, wb_avatar_widget, GTK_TYPE_WIDGET)
 
-static void on_message_complete (SoupSession *session,
-                                 SoupMessage *msg,
-                                 gpointer user_data);
+static void
+avatar_loaded_cb (GObject *source_object,
+                  GAsyncResult *result,
+                  gpointer user_data)
+{
+    cairo_surface_t *surface;
+    GError *error = NULL;
+    WbAvatarWidget *self;
+    WbAvatarWidgetPrivate *priv;
 
-void
-wb_avatar_widget_setup (WbAvatarWidget *self,
-                        const gchar *uri)
+    surface = wb_image_loader_load_finish (WB_IMAGE_LOADER (source_object),
+                                           result, &error);
+    if (surface == NULL)
+    {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_warning ("Failed to fetch avatar: %s", error->message);
+        }
+
+        g_error_free (error);
+
+        return;
+    }
+
+    /* @self is still alive, otherwise the request would have been
+     * cancelled. */
+    self = WB_AVATAR_WIDGET (user_data);
+    priv = wb_avatar_widget_get_instance_private (self);
+
+    wb_util_image_loaded (&priv->lazy_image);
+
+    priv->surface = surface;
+
+    gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+static void
+wb_avatar_widget_maybe_load (WbAvatarWidget *self)
 {
-    SoupMessage *msg;
+    const gchar *uri;
+    gint scale_factor;
+    WbImageLoader *loader;
     WbAvatarWidgetPrivate *priv = wb_avatar_widget_get_instance_private (self);
 
-    priv->width = 50;
-    priv->height = 50;
+    if (priv->user == NULL || priv->surface != NULL ||
+        !gtk_widget_get_mapped (GTK_WIDGET (self)))
+    {
+        return;
+    }
 
-    msg = soup_message_new (SOUP_METHOD_GET, uri);
-    soup_session_queue_message (SOUPSESSION, msg,
-                                on_message_complete, self);
+    loader = wb_application_get_image_loader (WB_APPLICATION (g_application_get_default ()));
+    scale_factor = gtk_widget_get_scale_factor (GTK_WIDGET (self));
+    uri = wb_user_get_avatar_url (priv->user, priv->width * scale_factor);
+
+    /* Avatars of the same user are usually shown many times. */
+    if (priv->lazy_image.cancellable == NULL)
+    {
+        priv->surface = wb_image_loader_lookup (loader, uri,
+                                                priv->width, priv->height,
+                                                scale_factor,
+                                                WB_IMAGE_SCALE_CROP);
+        if (priv->surface != NULL)
+        {
+            wb_util_untrack_viewport (&priv->lazy_image);
+            gtk_widget_queue_draw (GTK_WIDGET (self));
+
+            return;
+        }
+    }
+
+    if (wb_util_queue_image (&priv->lazy_image, GTK_WIDGET (self), loader,
+                             WB_IMAGE_PRIORITY_AVATAR))
+    {
+        wb_image_loader_load_async (loader, uri, priv->width, priv->height,
+                                    scale_factor, WB_IMAGE_SCALE_CROP,
+                                    priv->lazy_image.priority,
+                                    priv->lazy_image.cancellable,
+                                    avatar_loaded_cb, self);
+    }
 }
 
 static void
-on_message_complete (SoupSession *session,
-                     SoupMessage *msg,
-                     gpointer user_data)
+scale_factor_changed_cb (GObject *object,
+                         GParamSpec *pspec,
+                         gpointer user_data)
 {
-    g_autoptr(GInputStream) stream = NULL;
-    GError *error = NULL;
-    WbAvatarWidget *self = WB_AVATAR_WIDGET (user_data);
+    WbAvatarWidget *self = WB_AVATAR_WIDGET (object);
     WbAvatarWidgetPrivate *priv = wb_avatar_widget_get_instance_private (self);
 
-    if (!SOUP_STATUS_IS_SUCCESSFUL (msg->status_code) &&
-        msg->status_code != SOUP_STATUS_CANCELLED)
+    /* Load the avatar again at the new resolution. */
+    wb_util_cancel_image (&priv->lazy_image);
+    if (priv->surface != NULL)
     {
-        g_warning ("Failed to fetch avatar: %d %s.\n",
-                   msg->status_code, msg->reason_phrase);
-
-        return;
+        cairo_surface_destroy (priv->surface);
+        priv->surface = NULL;
     }
 
-    stream = g_memory_input_stream_new_from_data (msg->response_body->data,
-                                                  msg->response_body->length,
-                                                  NULL);
-    priv->pixbuf = gdk_pixbuf_new_from_stream (stream, NULL, &error);
-    if (error != NULL)
+    if (gtk_widget_get_mapped (GTK_WIDGET (self)))
     {
-        g_warning ("Unable to create pixbuf: %s",
-                   error->message);
-        g_clear_error (&error);
+        wb_util_track_viewport (&priv->lazy_image, GTK_WIDGET (self),
+                                G_CALLBACK (wb_avatar_widget_maybe_load));
+        wb_avatar_widget_maybe_load (self);
     }
+}
 
-    priv->surface = gdk_cairo_surface_create_from_pixbuf (priv->pixbuf, 0, NULL);
+/**
+ * wb_avatar_widget_setup:
+ * @self: a #WbAvatarWidget
+ * @user: the #WbUser to show the avatar of
+ *
+ * The avatar is picked from the sizes offered by @user according to
+ * the scale factor of @self.
+ */
+void
+wb_avatar_widget_setup (WbAvatarWidget *self,
+                        WbUser *user)
+{
+    WbAvatarWidgetPrivate *priv = wb_avatar_widget_get_instance_private (self);
 
-    gtk_widget_queue_draw (GTK_WIDGET (self));
+    priv->width = 50;
+    priv->height = 50;
+
+    g_set_object (&priv->user, user);
+
+    wb_avatar_widget_maybe_load (self);
 }
 
 static gboolean
@@ -208,6 +282,16 @@ wb_avatar_widget_unrealize (GtkWidget *widget)
     GTK_WIDGET_CLASS (wb_avatar_widget_parent_class)->unrealize (widget);
 }
 
+static void
+wb_avatar_widget_size_allocate (GtkWidget *widget,
+                                GtkAllocation *allocation)
+{
+    GTK_WIDGET_CLASS (wb_avatar_widget_parent_class)->size_allocate (widget,
+                                                                     allocation);
+
+    wb_avatar_widget_maybe_load (WB_AVATAR_WIDGET (widget));
+}
+
 static void
 wb_avatar_widget_map (GtkWidget *widget)
 {
@@ -223,6 +307,13 @@ wb_avatar_widget_map (GtkWidget *widget)
     {
         gdk_window_show (priv->event_window);
     }
+
+    if (priv->surface == NULL)
+    {
+        wb_util_track_viewport (&priv->lazy_image, GTK_WIDGET (self),
+                                G_CALLBACK (wb_avatar_widget_maybe_load));
+        wb_avatar_widget_maybe_load (self);
+    }
 }
 
 static void
@@ -239,22 +330,34 @@ wb_avatar_widget_unmap (GtkWidget *widget)
         gdk_window_hide (priv->event_window);
     }
 
+    /* Don't spend bandwidth on avatars which are not shown anymore. */
+    wb_util_cancel_image (&priv->lazy_image);
+
     GTK_WIDGET_CLASS (wb_avatar_widget_parent_class)->unmap (widget);
 }
 
+static void
+wb_avatar_widget_dispose (GObject *object)
+{
+    WbAvatarWidget *self = WB_AVATAR_WIDGET (object);
+    WbAvatarWidgetPrivate *priv = wb_avatar_widget_get_instance_private (self);
+
+    wb_util_cancel_image (&priv->lazy_image);
+    g_clear_object (&priv->user);
+
+    G_OBJECT_CLASS (wb_avatar_widget_parent_class)->dispose (object);
+}
+
 static void
 wb_avatar_widget_finalize (GObject *object)
 {
     WbAvatarWidget *self = (WbAvatarWidget *)object;
     WbAvatarWidgetPrivate *priv = wb_avatar_widget_get_instance_private (self);
 
-    if (priv->pixbuf != NULL)
-    {
-        g_object_unref (priv->pixbuf);
-    }
-    if (priv->scaled_pixbuf != NULL)
+    /* Let the cache drop the avatar once nothing shows it. */
+    if (priv->surface != NULL)
     {
-        g_object_unref (priv->scaled_pixbuf);
+        cairo_surface_destroy (priv->surface);
     }
 
     G_OBJECT_CLASS (wb_avatar_widget_parent_class)->finalize (object);
@@ -266,12 +369,14 @@ wb_avatar_widget_class_init (WbAvatarWidgetClass *klass)
 		GObjectClass *object_class = G_OBJECT_CLASS (klass);
     GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
+		object_class->dispose = wb_avatar_widget_dispose;
 		object_class->finalize = wb_avatar_widget_finalize;
 
     widget_class->draw = wb_avatar_widget_draw;
     widget_class->get_request_mode = wb_avatar_widget_get_request_mode;
     widget_class->get_preferred_height = wb_avatar_widget_get_preferred_height;
     widget_class->get_preferred_width = wb_avatar_widget_get_preferred_width;
+    widget_class->size_allocate = wb_avatar_widget_size_allocate;
     widget_class->realize = wb_avatar_widget_realize;
     widget_class->unrealize = wb_avatar_widget_unrealize;
     widget_class->map = wb_avatar_widget_map;
@@ -291,9 +396,15 @@ wb_avatar_widget_init (WbAvatarWidget *self)
     priv = wb_avatar_widget_get_instance_private (self);
 
     priv->event_window = NULL;
-    priv->pixbuf = NULL;
-    priv->scaled_pixbuf = NULL;
+    priv->lazy_image.vadjustment = NULL;
+    priv->lazy_image.value_changed_id = 0;
+    priv->lazy_image.cancellable = NULL;
+    priv->lazy_image.priority = WB_IMAGE_PRIORITY_PREFETCH;
+    priv->user = NULL;
     priv->surface = NULL;
+
+    g_signal_connect (self, "notify::scale-factor",
+                      G_CALLBACK (scale_factor_changed_cb), NULL);
 }
 
 /**
@@ -20,13 +20,15 @@
 
 #include <gtk/gtk.h>
 
+#include "wb-user.h"
+
 G_BEGIN_DECLS
 
 #define WB_TYPE_AVATAR_WIDGET (wb_avatar_widget_get_type ())
 
 G_DECLARE_FINAL_TYPE (WbAvatarWidget, wb_avatar_widget, WB, AVATAR_WIDGET, GtkWidget)
 
-void wb_avatar_widget_setup (WbAvatarWidget *self, const gchar *uri);
+void wb_avatar_widget_setup (WbAvatarWidget *self, WbUser *user);
 WbAvatarWidget *wb_avatar_widget_new (void);
 
 G_END_DECLS
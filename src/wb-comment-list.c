@@ -20,14 +20,18 @@
 #include <gmodule.h>
 #include <gtk/gtk.h>
 #include <json-glib/json-glib.h>
-#include <rest/oauth2-proxy.h>
 
+#include "wb-api-client.h"
+#include "wb-application.h"
 #include "wb-comment.h"
 #include "wb-comment-list.h"
 #include "wb-comment-row.h"
 #include "wb-compose-window.h"
 #include "wb-util.h"
 
+/* Comments fetched at a time. */
+#define COMMENTS_PAGE_SIZE 50
+
 enum
 {
     PROP_0,
@@ -43,9 +47,28 @@ struct _WbCommentList
 
 typedef struct
 {
-    const gchar *tweet_id;
+    gchar *tweet_id;
     gchar *current_cid;
+    GCancellable *cancellable;
+    /* Every comment shown or waiting to be, by id. */
     GHashTable *comments;
+    /* Rows of the comments replied to, by id. */
+    GHashTable *threads;
+    /* Replies whose root comment has not arrived yet, by root id. It
+     * may come with a later page, or never as Weibo API doesn't return
+     * all the comments. */
+    GHashTable *orphans;
+    gchar *idstr;
+    /* Oldest comment fetched from Weibo API so far, 0 before the first
+     * page. Older ones are fetched a page at a time. */
+    gint64 oldest_id;
+    gboolean fetching;
+    /* The page being fetched is shown as soon as it arrives, otherwise
+     * it is kept in next_page until it is asked for. */
+    gboolean show_page;
+    GPtrArray *next_page;
+    /* No comments older than oldest_id. */
+    gboolean exhausted;
 } WbCommentListPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (WbCommentList, wb_comment_list, GTK_TYPE_LIST_BOX)
@@ -60,275 +83,381 @@ wb_comment_list_set_tweet_id (WbCommentList *self,
 
     priv = wb_comment_list_get_instance_private (self);
 
-    priv->tweet_id = tweet_id;
+    g_free (priv->tweet_id);
+    priv->tweet_id = g_strdup (tweet_id);
 }
 
+/* In any order, replies wait for the comment they reply to. */
 static void
-parse_weibo_comments (gpointer data,
-                      gpointer user_data)
+wb_comment_list_insert_comments (WbCommentList *self,
+                                 GPtrArray *comments)
 {
-    JsonObject *object;
-    WbComment *comment;
-    WbCommentRow *comment_row;
-    WbCommentList *self = WB_COMMENT_LIST (user_data);
-
-    object = json_node_get_object (data);
-    comment = wb_comment_new (object);
-    comment_row = wb_comment_row_new (comment);
+    guint i;
+    WbStore *store;
 
-    wb_comment_list_insert_comment_widget (self, comment_row);
+    for (i = 0; i < comments->len; i++)
+    {
+        wb_comment_list_insert_comment (self, g_ptr_array_index (comments, i));
+    }
 
-    g_object_unref (comment);
+    store = wb_application_get_store (WB_APPLICATION (g_application_get_default ()));
+    wb_store_save_comments (store, (WbComment **) comments->pdata, comments->len);
 }
 
+static void wb_comment_list_fetch_page (WbCommentList *self);
+
 static void
-comments_show_finished_cb (RestProxyCall *call,
-                           const GError *error,
-                           GObject *weak_object,
+comments_show_finished_cb (GObject *source_object,
+                           GAsyncResult *result,
                            gpointer user_data)
 {
-    const gchar *payload;
-    goffset payload_length;
-    GError *err = NULL;
-    JsonParser *parser;
-    JsonNode *root_node;
+    guint i;
+    gboolean first_page;
+    GError *error = NULL;
+    GPtrArray *comments;
     WbCommentList *self;
+    WbCommentListPrivate *priv;
 
-    if (error != NULL)
+    comments = wb_api_client_get_comments_finish (WB_API_CLIENT (source_object),
+                                                  result, &error);
+    if (comments == NULL)
     {
-        g_error ("Error calling Weibo API(2/comments/show): %s",
-                 error->message);
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_warning ("%s", error->message);
+
+            /* Try again when asked for more. */
+            self = WB_COMMENT_LIST (user_data);
+            priv = wb_comment_list_get_instance_private (self);
+            priv->fetching = FALSE;
+
+            /* Don't keep the page loading, unless comments recorded on
+             * disk are shown. */
+            if (priv->oldest_id == 0 && g_hash_table_size (priv->threads) == 0)
+            {
+                g_signal_emit (self, signals[NO_COMMENTS], 0, NULL);
+            }
+        }
+
+        g_error_free (error);
         return;
     }
 
     self = WB_COMMENT_LIST (user_data);
+    priv = wb_comment_list_get_instance_private (self);
 
-    payload = rest_proxy_call_get_payload (call);
-    payload_length = rest_proxy_call_get_payload_length (call);
+    first_page = priv->oldest_id == 0;
 
-    parser = json_parser_new ();
-    if (!json_parser_load_from_data (parser, payload, payload_length, &err))
+    priv->fetching = FALSE;
+    if (comments->len == 0)
     {
-        g_warning ("json_parser_load_data () failed: %s (%s, %d)",
-                   err->message,
-                   g_quark_to_string (err->domain),
-                   err->code);
-        g_error_free (err);
+        priv->exhausted = TRUE;
     }
+    for (i = 0; i < comments->len; i++)
+    {
+        WbComment *comment = g_ptr_array_index (comments, i);
 
-    root_node = json_parser_get_root (parser);
-    if (JSON_NODE_HOLDS_OBJECT (root_node))
+        if (priv->oldest_id == 0 || comment->id < priv->oldest_id)
+        {
+            priv->oldest_id = comment->id;
+        }
+    }
+
+    if (!priv->show_page)
     {
-        JsonObject *object;
+        priv->next_page = comments;
+        return;
+    }
 
-        object = json_node_get_object (root_node);
+    priv->show_page = FALSE;
+    wb_comment_list_insert_comments (self, comments);
+    g_ptr_array_unref (comments);
 
-        if (json_object_get_int_member (object, "total_number") == 0)
+    if (first_page)
+    {
+        /* Comments recorded on disk may be shown already, replies
+         * waiting for their root are not. */
+        if (g_hash_table_size (priv->threads) == 0)
         {
             g_signal_emit (self, signals[NO_COMMENTS], 0, NULL);
         }
         else
         {
-            GList *elements;
-            JsonArray *array;
-
-            array = json_object_get_array_member (object, "comments");
-            elements = json_array_get_elements (array);
-
-            /* All the comments fetched using Weibo API are sorted by descending
-             * time (new to old). While we need to insert older comments first,
-             * so that when we insert newer comments, we can find which comment
-             * it replies to, if it replies to one.
-             * The foreach function of JsonArray doesn't iterate from the last
-             * to the first element. So we need get a list of elements in the array
-             * and reverse it. */
-            elements = g_list_reverse (elements);
-            g_list_foreach (elements, parse_weibo_comments, self);
-
             g_signal_emit (self, signals[LOADED], 0, NULL);
-
-            g_list_free (elements);
         }
     }
 
-    g_object_unref (parser);
+    /* Have the next page ready by the time the end is reached. */
+    wb_comment_list_fetch_page (self);
 }
 
-void
-wb_comment_list_load_comments (WbCommentList *self,
-                               const gchar *idstr)
+/* Fetch the page of comments older than the ones fetched so far. */
+static void
+wb_comment_list_fetch_page (WbCommentList *self)
 {
-    g_autofree gchar *access_token = NULL;
-    g_autofree gchar *app_key = NULL;
-    g_autoptr (GError) error = NULL;
-    RestProxy *proxy;
-    RestProxyCall *call;
-
-    access_token = wb_util_get_access_token ();
-    app_key = wb_util_get_app_key ();
-
-    proxy = oauth2_proxy_new_with_token (app_key, access_token,
-                                         "https://api.weibo.com/oauth2/authorize",
-                                         "https://api.weibo.com", FALSE);
-    call = rest_proxy_new_call (proxy);
-    rest_proxy_call_set_function (call, "2/comments/show.json");
-    rest_proxy_call_set_method (call, "GET");
-    rest_proxy_call_add_param (call, "access_token", access_token);
-    rest_proxy_call_add_param (call, "id", idstr);
-
-    rest_proxy_call_async (call, comments_show_finished_cb,
-                           NULL, self, &error);
-
-    g_object_unref (call);
-    g_object_unref (proxy);
+    g_autofree gchar *max_id = NULL;
+    WbApiClient *client;
+    WbCommentListPrivate *priv;
+
+    priv = wb_comment_list_get_instance_private (self);
+
+    if (priv->fetching || priv->exhausted || priv->next_page != NULL)
+    {
+        return;
+    }
+
+    priv->fetching = TRUE;
+
+    /* max_id is inclusive. */
+    if (priv->oldest_id != 0)
+    {
+        max_id = g_strdup_printf ("%" G_GINT64_FORMAT, priv->oldest_id - 1);
+    }
+
+    client = wb_application_get_api_client (WB_APPLICATION (g_application_get_default ()));
+    wb_api_client_get_comments_async (client, priv->idstr, max_id,
+                                      COMMENTS_PAGE_SIZE, priv->cancellable,
+                                      comments_show_finished_cb, self);
 }
 
+/**
+ * wb_comment_list_load_more:
+ * @self: a #WbCommentList
+ *
+ * Show the next page of older comments, at the end of the list. It is
+ * usually fetched already, otherwise it is shown once it arrives.
+ */
 void
-wb_comment_list_insert_comment_widget (WbCommentList *self,
-                                       WbCommentRow *comment_widget)
+wb_comment_list_load_more (WbCommentList *self)
 {
-    WbComment *comment;
     WbCommentListPrivate *priv;
 
-    priv = wb_comment_list_get_instance_private (self);
+    g_return_if_fail (WB_IS_COMMENT_LIST (self));
 
-    comment = wb_comment_row_get_comment (comment_widget);
-    g_hash_table_insert (priv->comments, &comment->id, comment_widget);
+    priv = wb_comment_list_get_instance_private (self);
 
-    if (comment->reply_comment)
+    if (priv->idstr == NULL)
     {
-        /* This is a comment which replies to another one. */
-        WbCommentRow *root_comment;
-
-        root_comment = g_hash_table_lookup (priv->comments, &comment->rootid);
+        return;
+    }
 
-        /* The root comment is somehow not found in the comment list. It
-         * can be caused by the broken Weibo API: Not all the comments
-         * will be available. */
-        if (root_comment == NULL)
+    /* The first page failed, fetch it again. */
+    if (priv->oldest_id == 0)
+    {
+        if (!priv->fetching)
         {
-            return;
+            priv->show_page = TRUE;
+            wb_comment_list_fetch_page (self);
         }
 
-        wb_comment_row_insert_reply (WB_COMMENT_ROW (root_comment), comment);
+        return;
+    }
+
+    if (priv->next_page != NULL)
+    {
+        GPtrArray *comments;
+
+        comments = g_steal_pointer (&priv->next_page);
+        wb_comment_list_insert_comments (self, comments);
+        g_ptr_array_unref (comments);
+
+        wb_comment_list_fetch_page (self);
     }
     else
     {
-        /* This is not a comment which replies to any other ones,
-         * insert it to the list box directly. */
-        gtk_list_box_prepend (GTK_LIST_BOX (self), GTK_WIDGET (comment_widget));
+        priv->show_page = TRUE;
+        wb_comment_list_fetch_page (self);
     }
 }
 
 static void
-wb_comment_list_add_comment (WbCommentList *self,
-                             const gchar *cid,
-                             const gchar *comment)
+comments_restored_cb (GObject *source_object,
+                      GAsyncResult *result,
+                      gpointer user_data)
 {
-    const gchar *payload;
-    g_autofree gchar *access_token = NULL;
-    g_autofree gchar *app_key = NULL;
-    gssize payload_length;
     GError *error = NULL;
-    JsonNode *root_node;
-    JsonParser *parser;
-    RestProxy *proxy;
-    RestProxyCall *call;
+    GPtrArray *comments;
+    WbCommentList *self;
+
+    comments = wb_store_load_comments_finish (WB_STORE (source_object),
+                                              result, &error);
+    if (comments == NULL)
+    {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_warning ("%s", error->message);
+        }
+
+        g_error_free (error);
+        return;
+    }
+
+    self = WB_COMMENT_LIST (user_data);
+
+    /* Without any, wait for Weibo API to tell whether there are. */
+    if (comments->len != 0)
+    {
+        wb_comment_list_insert_comments (self, comments);
+        g_signal_emit (self, signals[LOADED], 0, NULL);
+    }
+
+    g_ptr_array_unref (comments);
+}
+
+void
+wb_comment_list_load_comments (WbCommentList *self,
+                               const gchar *idstr)
+{
+    WbStore *store;
+    WbCommentListPrivate *priv;
+    WbApplication *application;
+
+    priv = wb_comment_list_get_instance_private (self);
+
+    application = WB_APPLICATION (g_application_get_default ());
+
+    /* Show the comments recorded on disk while the latest ones are
+     * fetched, both are merged. */
+    store = wb_application_get_store (application);
+    wb_store_load_comments_async (store, g_ascii_strtoll (idstr, NULL, 10),
+                                  priv->cancellable,
+                                  comments_restored_cb, self);
+
+    g_free (priv->idstr);
+    priv->idstr = g_strdup (idstr);
+    priv->show_page = TRUE;
+    wb_comment_list_fetch_page (self);
+}
+
+/**
+ * wb_comment_list_insert_comment:
+ * @self: a #WbCommentList
+ * @comment: a #WbComment
+ *
+ * Show @comment in its thread, unless it is shown already. A reply is
+ * shown once the comment it replies to is.
+ */
+void
+wb_comment_list_insert_comment (WbCommentList *self,
+                                WbComment *comment)
+{
+    GPtrArray *replies;
+    WbCommentRow *comment_row;
     WbCommentListPrivate *priv;
 
+    g_return_if_fail (WB_IS_COMMENT_LIST (self));
+    g_return_if_fail (WB_IS_COMMENT (comment));
+
     priv = wb_comment_list_get_instance_private (self);
 
-    access_token = wb_util_get_access_token ();
-    app_key = wb_util_get_app_key ();
-
-    proxy = oauth2_proxy_new_with_token (app_key, access_token,
-                                         "https://api.weibo.com/oauth2/authorize",
-                                         "https://api.weibo.com", FALSE);
-    call = rest_proxy_new_call (proxy);
-    rest_proxy_call_set_function (call, "2/comments/reply.json");
-    rest_proxy_call_set_method (call, "POST");
-    rest_proxy_call_add_param (call, "access_token", access_token);
-    rest_proxy_call_add_param (call, "id", priv->tweet_id);
-    rest_proxy_call_add_param (call, "cid", cid);
-    rest_proxy_call_add_param (call, "comment", comment);
-
-    rest_proxy_call_sync (call, &error);
-    if (error != NULL)
+    /* Loaded from disk or with another page already. */
+    if (g_hash_table_contains (priv->comments, &comment->id))
     {
-        GError *parser_error = NULL;
+        return;
+    }
 
-        payload = rest_proxy_call_get_payload (call);
-        payload_length = rest_proxy_call_get_payload_length (call);
+    g_hash_table_insert (priv->comments, &comment->id, g_object_ref (comment));
 
-        parser = json_parser_new ();
-        if (!json_parser_load_from_data (parser, payload,
-                                         payload_length, &parser_error))
+    if (comment->reply_comment)
+    {
+        /* This is a comment which replies to another one. */
+        comment_row = g_hash_table_lookup (priv->threads, &comment->rootid);
+        if (comment_row != NULL)
         {
-            g_warning ("Failed to parse comment data: %s (%s, %d)",
-                       parser_error->message,
-                       g_quark_to_string (parser_error->domain),
-                       parser_error->code);
-            g_error_free (parser_error);
+            wb_comment_row_insert_reply (comment_row, comment);
+            return;
         }
 
-        root_node = json_parser_get_root (parser);
-        if (JSON_NODE_HOLDS_OBJECT (root_node))
+        replies = g_hash_table_lookup (priv->orphans, &comment->rootid);
+        if (replies == NULL)
         {
-            JsonObject *object;
+            replies = g_ptr_array_new_with_free_func (g_object_unref);
+            /* The key points into the first reply, kept as long. */
+            g_hash_table_insert (priv->orphans, &comment->rootid, replies);
+        }
+        g_ptr_array_add (replies, g_object_ref (comment));
 
-            object = json_node_get_object (root_node);
+        return;
+    }
 
-            g_warning ("Failed to send request: %s (%s, %s)",
-                       json_object_get_string_member (object, "request"),
-                       json_object_get_string_member (object, "error_code"),
-                       json_object_get_string_member (object, "error"));
-        }
-        else
+    /* This is not a comment which replies to any other ones, insert it
+     * to the list box directly, where it belongs. */
+    comment_row = wb_comment_row_new (comment);
+    g_hash_table_insert (priv->threads, &comment->id, comment_row);
+    gtk_list_box_insert (GTK_LIST_BOX (self), GTK_WIDGET (comment_row), -1);
+
+    /* Along with the replies which came before it. */
+    replies = g_hash_table_lookup (priv->orphans, &comment->id);
+    if (replies != NULL)
+    {
+        guint i;
+
+        for (i = 0; i < replies->len; i++)
         {
-            g_warning ("Error calling Weibo API(2/comments/reply): %s",
-                       error->message);
-            g_error_free (error);
+            wb_comment_row_insert_reply (comment_row,
+                                         g_ptr_array_index (replies, i));
         }
+
+        g_hash_table_remove (priv->orphans, &comment->id);
     }
-    else
-    {
-        payload = rest_proxy_call_get_payload (call);
-        payload_length = rest_proxy_call_get_payload_length (call);
+}
 
-        parser = json_parser_new ();
-        if (!json_parser_load_from_data (parser, payload,
-                                         payload_length, &error))
+static void
+comments_reply_finished_cb (GObject *source_object,
+                            GAsyncResult *result,
+                            gpointer user_data)
+{
+    GError *error = NULL;
+    JsonNode *root_node;
+
+    root_node = wb_api_client_reply_comment_finish (WB_API_CLIENT (source_object),
+                                                    result, &error);
+    if (root_node == NULL)
+    {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
         {
-            g_warning ("Failed to parse comment data: %s (%s, %d)",
-                       error->message,
-                       g_quark_to_string (error->domain),
-                       error->code);
-            g_error_free (error);
+            g_warning ("%s", error->message);
         }
 
-        root_node = json_parser_get_root (parser);
-        if (JSON_NODE_HOLDS_OBJECT (root_node))
-        {
-            JsonObject *object;
-            WbComment *comment;
-            WbCommentRow *comment_row;
+        g_error_free (error);
+        return;
+    }
 
-            object = json_node_get_object (root_node);
+    if (JSON_NODE_HOLDS_OBJECT (root_node))
+    {
+        JsonObject *object;
+        WbComment *comment;
+        WbEntityStore *store;
 
-            /* Parse the data and insert a comment row */
-            comment = wb_comment_new (object);
-            comment_row = wb_comment_row_new (comment);
+        object = json_node_get_object (root_node);
 
-            wb_comment_list_insert_comment_widget (WB_COMMENT_LIST (self),
-                                                   comment_row);
+        /* Parse the data and insert it in its thread */
+        comment = wb_comment_new (object);
+        store = wb_application_get_entity_store (WB_APPLICATION (g_application_get_default ()));
+        wb_entity_store_intern_comment (store, comment);
 
-            g_object_unref (comment);
-        }
+        wb_comment_list_insert_comment (WB_COMMENT_LIST (user_data), comment);
+
+        g_object_unref (comment);
     }
 
-    g_object_unref (call);
-    g_object_unref (parser);
-    g_object_unref (proxy);
+    json_node_unref (root_node);
+}
+
+static void
+wb_comment_list_add_comment (WbCommentList *self,
+                             const gchar *cid,
+                             const gchar *comment)
+{
+    WbApiClient *client;
+    WbCommentListPrivate *priv;
+
+    priv = wb_comment_list_get_instance_private (self);
+
+    client = wb_application_get_api_client (WB_APPLICATION (g_application_get_default ()));
+    wb_api_client_reply_comment_async (client, priv->tweet_id, cid, comment,
+                                       priv->cancellable,
+                                       comments_reply_finished_cb, self);
 }
 
 static void
@@ -412,6 +541,43 @@ listbox_update_header_func (GtkListBoxRow *row,
     }
 }
 
+/* Newest comments first, whatever page they came in. */
+static gint
+listbox_sort_func (GtkListBoxRow *row1,
+                   GtkListBoxRow *row2,
+                   gpointer user_data)
+{
+    WbComment *comment1;
+    WbComment *comment2;
+
+    comment1 = wb_comment_row_get_comment (WB_COMMENT_ROW (row1));
+    comment2 = wb_comment_row_get_comment (WB_COMMENT_ROW (row2));
+
+    return comment1->id < comment2->id ? 1
+           : comment1->id > comment2->id ? -1 : 0;
+}
+
+static void
+wb_comment_list_dispose (GObject *object)
+{
+    WbCommentList *self = WB_COMMENT_LIST (object);
+    WbCommentListPrivate *priv = wb_comment_list_get_instance_private (self);
+
+    if (priv->cancellable != NULL)
+    {
+        g_cancellable_cancel (priv->cancellable);
+        g_clear_object (&priv->cancellable);
+    }
+
+    g_clear_pointer (&priv->next_page, g_ptr_array_unref);
+    /* Keys point into the comments. */
+    g_hash_table_remove_all (priv->threads);
+    g_hash_table_remove_all (priv->orphans);
+    g_hash_table_remove_all (priv->comments);
+
+    G_OBJECT_CLASS (wb_comment_list_parent_class)->dispose (object);
+}
+
 static void
 wb_comment_list_finalize (GObject *object)
 {
@@ -422,7 +588,11 @@ wb_comment_list_finalize (GObject *object)
     priv = wb_comment_list_get_instance_private (self);
 
     g_free (priv->current_cid);
+    g_free (priv->idstr);
+    g_free (priv->tweet_id);
 
+    g_hash_table_destroy (priv->orphans);
+    g_hash_table_destroy (priv->threads);
     g_hash_table_destroy (priv->comments);
 
     G_OBJECT_CLASS (wb_comment_list_parent_class)->finalize (object);
@@ -433,6 +603,7 @@ wb_comment_list_class_init (WbCommentListClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
+    object_class->dispose = wb_comment_list_dispose;
     object_class->finalize = wb_comment_list_finalize;
 
     signals[LOADED] = g_signal_new ("loaded",
@@ -462,13 +633,27 @@ wb_comment_list_init (WbCommentList *self)
 
     priv = wb_comment_list_get_instance_private (self);
 
-    priv->comments = g_hash_table_new (g_int64_hash, g_int64_equal);
+    priv->cancellable = g_cancellable_new ();
+    priv->comments = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                            NULL, g_object_unref);
+    priv->threads = g_hash_table_new (g_int64_hash, g_int64_equal);
+    priv->orphans = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                           NULL,
+                                           (GDestroyNotify) g_ptr_array_unref);
     priv->current_cid = NULL;
     priv->tweet_id = NULL;
+    priv->idstr = NULL;
+    priv->oldest_id = 0;
+    priv->fetching = FALSE;
+    priv->show_page = FALSE;
+    priv->next_page = NULL;
+    priv->exhausted = FALSE;
 
     gtk_list_box_set_header_func (GTK_LIST_BOX (self),
                                   (GtkListBoxUpdateHeaderFunc) listbox_update_header_func,
                                   NULL, NULL);
+    gtk_list_box_set_sort_func (GTK_LIST_BOX (self), listbox_sort_func,
+                                NULL, NULL);
     gtk_list_box_set_selection_mode (GTK_LIST_BOX (self), GTK_SELECTION_NONE);
 
     g_signal_connect (self, "row-activated",
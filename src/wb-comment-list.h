@@ -31,8 +31,9 @@ G_DECLARE_FINAL_TYPE (WbCommentList, wb_comment_list, WB, COMMENT_LIST, GtkListB
 
 void wb_comment_list_set_tweet_id (WbCommentList *list, const gchar *tweet_id);
 void wb_comment_list_load_comments (WbCommentList *self, const gchar *idstr);
-void wb_comment_list_insert_comment_widget (WbCommentList *list,
-                                            WbCommentRow *comment_widget);
+void wb_comment_list_load_more (WbCommentList *self);
+void wb_comment_list_insert_comment (WbCommentList *self,
+                                     WbComment *comment);
 WbCommentList *wb_comment_list_new (void);
 
 G_END_DECLS
@@ -51,6 +51,9 @@ G_DEFINE_TYPE_WITH_PRIVATE (WbCommentRow, wb_comment_row, GTK_TYPE_LIST_BOX_ROW)
 
 static GParamSpec *obj_properties [N_PROPS];
 
+/* The reply shown in a row of the reply list box. */
+static GQuark reply_quark;
+
 WbComment *
 wb_comment_row_get_comment (WbCommentRow *self)
 {
@@ -67,6 +70,7 @@ wb_comment_row_insert_reply (WbCommentRow *self,
 {
     GtkWidget *comment_label;
     GtkWidget *hbox;
+    GtkWidget *row;
     WbNameButton *name_button;
     WbCommentRowPrivate *priv;
 
@@ -76,16 +80,8 @@ wb_comment_row_insert_reply (WbCommentRow *self,
 
     hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 3);
 
-    if (g_strcmp0 (comment->user->nickname, "") != 0)
-    {
-        name_button = wb_name_button_new ();
-        wb_name_button_set_text (name_button, comment->user->nickname);
-    }
-    else
-    {
-        name_button = wb_name_button_new ();
-        wb_name_button_set_text (name_button, comment->user->name);
-    }
+    name_button = wb_name_button_new ();
+    wb_name_button_set_user (name_button, comment->user);
     gtk_widget_set_halign (GTK_WIDGET (name_button), GTK_ALIGN_START);
     gtk_widget_set_valign (GTK_WIDGET (name_button), GTK_ALIGN_START);
     gtk_box_pack_start (GTK_BOX (hbox), GTK_WIDGET (name_button), FALSE, FALSE, 0);
@@ -94,9 +90,14 @@ wb_comment_row_insert_reply (WbCommentRow *self,
     gtk_widget_set_halign (comment_label, GTK_ALIGN_START);
     gtk_label_set_line_wrap (GTK_LABEL (comment_label), TRUE);
     gtk_box_pack_start (GTK_BOX (hbox), comment_label, FALSE, FALSE, 0);
-    gtk_widget_show_all (hbox);
 
-    gtk_container_add (GTK_CONTAINER (priv->reply_listbox), hbox);
+    row = gtk_list_box_row_new ();
+    g_object_set_qdata_full (G_OBJECT (row), reply_quark,
+                             g_object_ref (comment), g_object_unref);
+    gtk_container_add (GTK_CONTAINER (row), hbox);
+    gtk_widget_show_all (row);
+
+    gtk_container_add (GTK_CONTAINER (priv->reply_listbox), row);
 
     if (gtk_widget_get_visible (priv->reply_listbox) == FALSE)
     {
@@ -104,33 +105,37 @@ wb_comment_row_insert_reply (WbCommentRow *self,
     }
 }
 
+/* Replies in the order they were posted, whichever page they came in. */
+static gint
+reply_listbox_sort_func (GtkListBoxRow *row1,
+                         GtkListBoxRow *row2,
+                         gpointer user_data)
+{
+    WbComment *reply1;
+    WbComment *reply2;
+
+    reply1 = g_object_get_qdata (G_OBJECT (row1), reply_quark);
+    reply2 = g_object_get_qdata (G_OBJECT (row2), reply_quark);
+
+    return reply1->id < reply2->id ? -1 : reply1->id > reply2->id ? 1 : 0;
+}
+
 static void
 wb_comment_row_constructed (GObject *object)
 {
-    gchar *created_at;
     WbCommentRow *self = WB_COMMENT_ROW (object);
     WbCommentRowPrivate *priv = wb_comment_row_get_instance_private (self);
 
     wb_avatar_widget_setup (WB_AVATAR_WIDGET (priv->avatar),
-                            priv->comment->user->profile_image_url);
+                            priv->comment->user);
 
-    if (g_strcmp0 (priv->comment->user->nickname, "") != 0)
-    {
-        wb_name_button_set_text (WB_NAME_BUTTON (priv->name_button),
-                                 priv->comment->user->nickname);
-    }
-    else
-    {
-        wb_name_button_set_text (WB_NAME_BUTTON (priv->name_button),
-                                 priv->comment->user->name);
-    }
+    wb_name_button_set_user (WB_NAME_BUTTON (priv->name_button),
+                             priv->comment->user);
 
-    created_at = wb_util_format_time_string (priv->comment->created_at);
-    gtk_label_set_text (GTK_LABEL (priv->time_label), created_at);
+    wb_util_set_time_label (GTK_LABEL (priv->time_label),
+                            priv->comment->created_at);
     gtk_label_set_text (GTK_LABEL (priv->comment_label), priv->comment->text);
 
-    g_free (created_at);
-
     G_OBJECT_CLASS (wb_comment_row_parent_class)->constructed (object);
 }
 
@@ -216,12 +221,21 @@ wb_comment_row_class_init (WbCommentRowClass *klass)
                                                   comment_label);
     gtk_widget_class_bind_template_child_private (widget_class, WbCommentRow,
                                                   reply_listbox);
+
+    reply_quark = g_quark_from_static_string ("wb-comment-row-reply");
 }
 
 static void
 wb_comment_row_init (WbCommentRow *self)
 {
+    WbCommentRowPrivate *priv;
+
+    priv = wb_comment_row_get_instance_private (self);
+
     gtk_widget_init_template (GTK_WIDGET (self));
+
+    gtk_list_box_set_sort_func (GTK_LIST_BOX (priv->reply_listbox),
+                                reply_listbox_sort_func, NULL, NULL);
 }
 
 /**
@@ -19,6 +19,7 @@
 #include <json-glib/json-glib.h>
 
 #include "wb-comment.h"
+#include "wb-util.h"
 
 G_DEFINE_TYPE (WbComment, wb_comment, G_TYPE_OBJECT)
 
@@ -29,8 +30,8 @@ wb_comment_parse_json_object (WbComment *self,
     JsonObject *user_object;
 
     self->reply_comment = json_object_has_member (jobject, "reply_comment");
-    self->created_at = g_strdup (json_object_get_string_member (jobject,
-                                                                "created_at"));
+    self->created_at = wb_util_parse_time_string (json_object_get_string_member (jobject,
+                                                                                 "created_at"));
     self->idstr = g_strdup (json_object_get_string_member (jobject, "idstr"));
     self->text = g_strdup (json_object_get_string_member (jobject, "text"));
 
@@ -52,10 +53,10 @@ wb_comment_finalize (GObject *object)
 {
     WbComment *self = WB_COMMENT (object);
 
-    g_free (self->created_at);
     g_free (self->idstr);
     g_free (self->text);
     g_object_unref (self->user);
+    g_free (self->json);
 
     G_OBJECT_CLASS (wb_comment_parent_class)->finalize (object);
 }
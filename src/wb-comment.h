@@ -30,12 +30,16 @@ struct _WbComment
     GObject parent_instance;
 
     gboolean reply_comment;
-    gchar *created_at;
     gchar *idstr;
     gchar *text;
+    gint64 created_at;
     gint64 id;
     gint64 rootid;
     WbUser *user;
+
+    /* The data Weibo API returned for the comment, until it is
+     * recorded on disk, or %NULL. See wb_store_save_comments(). */
+    gchar *json;
 };
 
 #define WB_TYPE_COMMENT (wb_comment_get_type ())
@@ -0,0 +1,262 @@
+/*
+ *  Weibird - View and compose weibo
+ *  Copyright (C) 2019 Jonathan Kang <jonathankang@gnome.org>.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wb-entity-store.h"
+
+struct _WbEntityStore
+{
+    GObject parent_instance;
+};
+
+typedef struct
+{
+    /* id → WbUser, not owned. Entries go away with the last reference
+     * to the user, the store only makes sure there is a single one of
+     * each user alive. */
+    GHashTable *users;
+    /* id → WbTweetItem, not owned either. */
+    GHashTable *statuses;
+} WbEntityStorePrivate;
+
+G_DEFINE_TYPE_WITH_PRIVATE (WbEntityStore, wb_entity_store, G_TYPE_OBJECT)
+
+static void
+user_disposed_cb (gpointer data,
+                  GObject *where_the_object_was)
+{
+    WbEntityStore *self = WB_ENTITY_STORE (data);
+    WbEntityStorePrivate *priv = wb_entity_store_get_instance_private (self);
+
+    /* Not finalized yet, the id is still there. */
+    g_hash_table_remove (priv->users,
+                         &((WbUser *) where_the_object_was)->id);
+}
+
+static void
+status_disposed_cb (gpointer data,
+                    GObject *where_the_object_was)
+{
+    WbEntityStore *self = WB_ENTITY_STORE (data);
+    WbEntityStorePrivate *priv = wb_entity_store_get_instance_private (self);
+
+    g_hash_table_remove (priv->statuses,
+                         &((WbTweetItem *) where_the_object_was)->id);
+}
+
+/**
+ * wb_entity_store_intern_user:
+ * @self: a #WbEntityStore
+ * @user: a #WbUser which was just parsed
+ *
+ * Get the #WbUser in use for the user @user describes. If there is
+ * one already, it is updated with @user, otherwise @user becomes it.
+ *
+ * Returns: (transfer full): the #WbUser to use instead of @user
+ */
+WbUser *
+wb_entity_store_intern_user (WbEntityStore *self,
+                             WbUser *user)
+{
+    WbUser *existing;
+    WbEntityStorePrivate *priv;
+
+    g_return_val_if_fail (WB_IS_ENTITY_STORE (self), NULL);
+    g_return_val_if_fail (WB_IS_USER (user), NULL);
+
+    priv = wb_entity_store_get_instance_private (self);
+
+    existing = g_hash_table_lookup (priv->users, &user->id);
+    if (existing != NULL)
+    {
+        if (existing != user)
+        {
+            wb_user_update (existing, user);
+        }
+
+        return g_object_ref (existing);
+    }
+
+    g_hash_table_insert (priv->users, &user->id, user);
+    g_object_weak_ref (G_OBJECT (user), user_disposed_cb, self);
+
+    return g_object_ref (user);
+}
+
+/**
+ * wb_entity_store_intern_status:
+ * @self: a #WbEntityStore
+ * @tweet_item: a #WbTweetItem which was just parsed
+ *
+ * Get the #WbTweetItem in use for the post @tweet_item describes, the
+ * same way as wb_entity_store_intern_user(). The author and the
+ * reposted post of @tweet_item are interned too.
+ *
+ * Returns: (transfer full): the #WbTweetItem to use instead of
+ * @tweet_item
+ */
+WbTweetItem *
+wb_entity_store_intern_status (WbEntityStore *self,
+                               WbTweetItem *tweet_item)
+{
+    WbTweetItem *existing;
+    WbEntityStorePrivate *priv;
+
+    g_return_val_if_fail (WB_IS_ENTITY_STORE (self), NULL);
+    g_return_val_if_fail (WB_IS_TWEET_ITEM (tweet_item), NULL);
+
+    priv = wb_entity_store_get_instance_private (self);
+
+    existing = g_hash_table_lookup (priv->statuses, &tweet_item->id);
+    if (existing == tweet_item)
+    {
+        return g_object_ref (existing);
+    }
+
+    if (tweet_item->user != NULL)
+    {
+        WbUser *user;
+
+        user = wb_entity_store_intern_user (self, tweet_item->user);
+        g_object_unref (tweet_item->user);
+        tweet_item->user = user;
+    }
+
+    if (tweet_item->retweeted_item != NULL)
+    {
+        WbTweetItem *retweeted_item;
+
+        retweeted_item = wb_entity_store_intern_status (self,
+                                                        tweet_item->retweeted_item);
+        g_object_unref (tweet_item->retweeted_item);
+        tweet_item->retweeted_item = retweeted_item;
+    }
+
+    if (existing != NULL)
+    {
+        wb_tweet_item_update_counts (existing, tweet_item);
+
+        return g_object_ref (existing);
+    }
+
+    g_hash_table_insert (priv->statuses, &tweet_item->id, tweet_item);
+    g_object_weak_ref (G_OBJECT (tweet_item), status_disposed_cb, self);
+
+    return g_object_ref (tweet_item);
+}
+
+/**
+ * wb_entity_store_intern_comment:
+ * @self: a #WbEntityStore
+ * @comment: a #WbComment which was just parsed
+ *
+ * Comments are not shared, but their authors are.
+ */
+void
+wb_entity_store_intern_comment (WbEntityStore *self,
+                                WbComment *comment)
+{
+    WbUser *user;
+
+    g_return_if_fail (WB_IS_ENTITY_STORE (self));
+    g_return_if_fail (WB_IS_COMMENT (comment));
+
+    if (comment->user == NULL)
+    {
+        return;
+    }
+
+    user = wb_entity_store_intern_user (self, comment->user);
+    g_object_unref (comment->user);
+    comment->user = user;
+}
+
+/**
+ * wb_entity_store_lookup_status:
+ * @self: a #WbEntityStore
+ * @id: id of the post
+ *
+ * Returns: (transfer none) (nullable): the #WbTweetItem in use for the
+ * post, or %NULL if there is none
+ */
+WbTweetItem *
+wb_entity_store_lookup_status (WbEntityStore *self,
+                               gint64 id)
+{
+    WbEntityStorePrivate *priv;
+
+    g_return_val_if_fail (WB_IS_ENTITY_STORE (self), NULL);
+
+    priv = wb_entity_store_get_instance_private (self);
+
+    return g_hash_table_lookup (priv->statuses, &id);
+}
+
+static void
+wb_entity_store_finalize (GObject *object)
+{
+    GHashTableIter iter;
+    gpointer value;
+    WbEntityStore *self = WB_ENTITY_STORE (object);
+    WbEntityStorePrivate *priv = wb_entity_store_get_instance_private (self);
+
+    g_hash_table_iter_init (&iter, priv->users);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        g_object_weak_unref (G_OBJECT (value), user_disposed_cb, self);
+    }
+    g_hash_table_iter_init (&iter, priv->statuses);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        g_object_weak_unref (G_OBJECT (value), status_disposed_cb, self);
+    }
+
+    g_hash_table_unref (priv->users);
+    g_hash_table_unref (priv->statuses);
+
+    G_OBJECT_CLASS (wb_entity_store_parent_class)->finalize (object);
+}
+
+static void
+wb_entity_store_class_init (WbEntityStoreClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->finalize = wb_entity_store_finalize;
+}
+
+static void
+wb_entity_store_init (WbEntityStore *self)
+{
+    WbEntityStorePrivate *priv = wb_entity_store_get_instance_private (self);
+
+    priv->users = g_hash_table_new (g_int64_hash, g_int64_equal);
+    priv->statuses = g_hash_table_new (g_int64_hash, g_int64_equal);
+}
+
+/**
+ * wb_entity_store_new:
+ *
+ * Create a new #WbEntityStore.
+ *
+ * Returns: (transfer full): a newly created #WbEntityStore
+ */
+WbEntityStore *
+wb_entity_store_new (void)
+{
+    return g_object_new (WB_TYPE_ENTITY_STORE, NULL);
+}
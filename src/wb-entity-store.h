@@ -0,0 +1,43 @@
+/*
+ *  Weibird - View and compose weibo
+ *  Copyright (C) 2019 Jonathan Kang <jonathankang@gnome.org>.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+#include "wb-comment.h"
+#include "wb-tweet-item.h"
+#include "wb-user.h"
+
+G_BEGIN_DECLS
+
+#define WB_TYPE_ENTITY_STORE (wb_entity_store_get_type ())
+
+G_DECLARE_FINAL_TYPE (WbEntityStore, wb_entity_store, WB, ENTITY_STORE, GObject)
+
+WbUser *wb_entity_store_intern_user (WbEntityStore *self,
+                                     WbUser *user);
+WbTweetItem *wb_entity_store_intern_status (WbEntityStore *self,
+                                            WbTweetItem *tweet_item);
+void wb_entity_store_intern_comment (WbEntityStore *self,
+                                     WbComment *comment);
+WbTweetItem *wb_entity_store_lookup_status (WbEntityStore *self,
+                                            gint64 id);
+WbEntityStore *wb_entity_store_new (void);
+
+G_END_DECLS
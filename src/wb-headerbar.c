@@ -35,6 +35,7 @@ struct _WbHeaderbar
 typedef struct
 {
     GtkWidget *back_button;
+    GtkWidget *refresh_button;
     GtkWidget *pri_menu;
     WbHeaderbarMode mode;
 } WbHeaderbarPrivate;
@@ -78,9 +79,11 @@ notify_mode_cb (GObject *object,
     {
         case WB_HEADERBAR_MODE_LIST:
             gtk_widget_hide (priv->back_button);
+            gtk_widget_show (priv->refresh_button);
             break;
         case WB_HEADERBAR_MODE_DETAIL:
             gtk_widget_show (priv->back_button);
+            gtk_widget_hide (priv->refresh_button);
             break;
         default:
             g_assert_not_reached ();
@@ -183,6 +186,8 @@ wb_headerbar_class_init (WbHeaderbarClass *klass)
                                                  "/com/jonathankang/Weibird/wb-headerbar.ui");
     gtk_widget_class_bind_template_child_private (widget_class, WbHeaderbar,
                                                   back_button);
+    gtk_widget_class_bind_template_child_private (widget_class, WbHeaderbar,
+                                                  refresh_button);
     gtk_widget_class_bind_template_child_private (widget_class, WbHeaderbar,
                                                   pri_menu);
     gtk_widget_class_bind_template_callback (widget_class, back_button_clicked_cb);
@@ -20,12 +20,21 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gio/gio.h>
 #include <gtk/gtk.h>
-#include <libsoup/soup.h>
 
+#include "wb-application.h"
 #include "wb-enums.h"
 #include "wb-image-button.h"
+#include "wb-image-loader.h"
 #include "wb-util.h"
 
+/* Width of the "bmiddle" images served by Weibo. */
+#define MIDDLE_IMAGE_WIDTH 440
+/* Upscaling a "bmiddle" image up to this width looks fine, and is much
+ * cheaper than downloading the original, often several megabytes. Grid
+ * cells stay under it even on HiDPI screens, only a picture shown on
+ * its own goes past it. */
+#define MAX_MIDDLE_IMAGE_WIDTH (MIDDLE_IMAGE_WIDTH * 5 / 4)
+
 enum
 {
     PROP_0,
@@ -59,9 +68,8 @@ typedef struct
     gint nth_media;
     gint width;
     gint height;
-    GdkPixbuf *pixbuf;
-    GdkPixbuf *scaled_pixbuf;
     GdkWindow *event_window;
+    WbLazyImage lazy_image;
     GtkWidget *image;
     WbMediaType type;
 } WbImageButtonPrivate;
@@ -87,12 +95,14 @@ wb_image_button_get_media_type (WbImageButton *self)
     return priv->type;
 }
 
-GdkPixbuf *
-wb_image_button_get_pixbuf (WbImageButton *self)
+static WbImageScaleMode
+wb_image_button_get_scale_mode (WbImageButton *self)
 {
     WbImageButtonPrivate *priv = wb_image_button_get_instance_private (self);
 
-    return priv->pixbuf;
+    /* Scale the image into thumbnail, for example 150*150 */
+    return priv->type == WB_MEDIA_TYPE_IMAGE ? WB_IMAGE_SCALE_CROP
+                                             : WB_IMAGE_SCALE_NONE;
 }
 
 static gboolean
@@ -136,95 +146,121 @@ wb_image_button_draw (GtkWidget *widget,
 }
 
 static void
-on_message_complete (SoupSession *session,
-                     SoupMessage *msg,
-                     gpointer user_data)
+image_loaded_cb (GObject *source_object,
+                 GAsyncResult *result,
+                 gpointer user_data)
 {
-    g_autoptr(GInputStream) stream = NULL;
+    cairo_surface_t *surface;
     GError *error = NULL;
-    WbImageButton *self = WB_IMAGE_BUTTON (user_data);
-    WbImageButtonPrivate *priv = wb_image_button_get_instance_private (self);
+    WbImageButton *self;
+    WbImageButtonPrivate *priv;
 
-    if (!SOUP_STATUS_IS_SUCCESSFUL (msg->status_code))
+    surface = wb_image_loader_load_finish (WB_IMAGE_LOADER (source_object),
+                                           result, &error);
+    if (surface == NULL)
     {
-        if (msg->status_code != SOUP_STATUS_CANCELLED)
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
         {
-            g_warning ("Failed to get image: %d %s.\n",
-                       msg->status_code, msg->reason_phrase);
+            g_warning ("Failed to get image: %s", error->message);
         }
+
+        g_error_free (error);
+
         return;
     }
 
+    /* @self is still alive, otherwise the request would have been
+     * cancelled. */
+    self = WB_IMAGE_BUTTON (user_data);
+    priv = wb_image_button_get_instance_private (self);
+
+    wb_util_image_loaded (&priv->lazy_image);
+
     priv->media_loaded = TRUE;
+    priv->surface = surface;
+
+    gtk_widget_queue_draw (GTK_WIDGET (self));
+}
 
-    stream = g_memory_input_stream_new_from_data (msg->response_body->data,
-                                                  msg->response_body->length,
-                                                  NULL);
-    priv->pixbuf = gdk_pixbuf_new_from_stream (stream, NULL, &error);
-    if (error != NULL)
+static void
+wb_image_button_maybe_load (WbImageButton *self)
+{
+    g_autofree gchar *mq_uri = NULL;
+    gint scale_factor;
+    WbImageLoader *loader;
+    WbImageScaleMode mode;
+    WbImageButtonPrivate *priv = wb_image_button_get_instance_private (self);
+
+    if (priv->media_loaded || !gtk_widget_get_mapped (GTK_WIDGET (self)))
     {
-        g_warning ("Unable to create pixbuf: %s",
-                   error->message);
-        g_clear_error (&error);
+        return;
     }
 
-    /* Scale the image into thumbnail (150*150) */
-    if (priv->type == WB_MEDIA_TYPE_IMAGE)
-    {
-        gdouble scale;
-        gint width, height;
-        gint offset;
+    loader = wb_application_get_image_loader (WB_APPLICATION (g_application_get_default ()));
+    mode = wb_image_button_get_scale_mode (self);
+    scale_factor = gtk_widget_get_scale_factor (GTK_WIDGET (self));
 
-        width = gdk_pixbuf_get_width (priv->pixbuf);
-        height = gdk_pixbuf_get_height (priv->pixbuf);
+    /* Scale middle quality image as thumbnail, unless it is much too
+     * small for a HiDPI screen. */
+    if (priv->width * scale_factor > MAX_MIDDLE_IMAGE_WIDTH)
+    {
+        mq_uri = wb_util_thumbnail_to_original (priv->uri);
+    }
+    else
+    {
+        mq_uri = wb_util_thumbnail_to_middle (priv->uri);
+    }
 
-        /* If the image is large enough, cropped the central square part
-         * of the image and scale it down to 150px by 150px */
-        if (width > priv->width && height > priv->height)
-        {
-            priv->scaled_pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB,
-                                                  gdk_pixbuf_get_has_alpha (priv->pixbuf),
-                                                  8, priv->width, priv->height);
-
-            if (width <= height)
-            {
-                scale = (gdouble) priv->width / width;
-                offset = (height - width) * scale / -2;
-
-                gdk_pixbuf_scale (priv->pixbuf, priv->scaled_pixbuf,
-                                  0, 0, priv->width, priv->height,
-                                  0, offset, scale, scale,
-                                  GDK_INTERP_BILINEAR);
-            }
-            else
-            {
-                scale = (gdouble) priv->height / height;
-                offset = (width - height) * scale / -2;
-
-                gdk_pixbuf_scale (priv->pixbuf, priv->scaled_pixbuf,
-                                  0, 0, priv->width, priv->height,
-                                  offset, 0, scale, scale,
-                                  GDK_INTERP_BILINEAR);
-            }
-        }
-        else
+    /* Another widget may have shown the same image already. */
+    if (priv->lazy_image.cancellable == NULL)
+    {
+        priv->surface = wb_image_loader_lookup (loader, mq_uri, priv->width,
+                                                priv->height, scale_factor,
+                                                mode);
+        if (priv->surface != NULL)
         {
-            priv->scaled_pixbuf = gdk_pixbuf_scale_simple (priv->pixbuf,
-                                                           priv->width,
-                                                           priv->height,
-                                                           GDK_INTERP_BILINEAR);
+            priv->media_loaded = TRUE;
+            wb_util_untrack_viewport (&priv->lazy_image);
+            gtk_widget_queue_draw (GTK_WIDGET (self));
+
+            return;
         }
+    }
 
-        priv->surface = gdk_cairo_surface_create_from_pixbuf (priv->scaled_pixbuf,
-                                                              0, NULL);
+    if (wb_util_queue_image (&priv->lazy_image, GTK_WIDGET (self), loader,
+                             WB_IMAGE_PRIORITY_THUMBNAIL))
+    {
+        wb_image_loader_load_async (loader, mq_uri, priv->width, priv->height,
+                                    scale_factor, mode,
+                                    priv->lazy_image.priority,
+                                    priv->lazy_image.cancellable,
+                                    image_loaded_cb, self);
     }
-    else
+}
+
+static void
+scale_factor_changed_cb (GObject *object,
+                         GParamSpec *pspec,
+                         gpointer user_data)
+{
+    WbImageButton *self = WB_IMAGE_BUTTON (object);
+    WbImageButtonPrivate *priv = wb_image_button_get_instance_private (self);
+
+    /* Load the image again at the new resolution. */
+    wb_util_cancel_image (&priv->lazy_image);
+    priv->media_loaded = FALSE;
+    if (priv->surface != NULL)
     {
-        priv->surface = gdk_cairo_surface_create_from_pixbuf (priv->pixbuf,
-                                                              0, NULL);
+        cairo_surface_destroy (priv->surface);
+        priv->surface = NULL;
     }
 
-    gtk_widget_queue_draw (GTK_WIDGET (self));
+    if (gtk_widget_get_mapped (GTK_WIDGET (self)))
+    {
+        wb_util_track_viewport (&priv->lazy_image, GTK_WIDGET (self),
+                                G_CALLBACK (wb_image_button_maybe_load));
+        wb_image_button_maybe_load (self);
+    }
 }
 
 static gboolean
@@ -375,6 +411,8 @@ wb_image_button_size_allocate (GtkWidget     *widget,
 				allocation->width,
 				allocation->height);
     }
+
+    wb_image_button_maybe_load (self);
 }
 
 static void
@@ -392,6 +430,13 @@ wb_image_button_map (GtkWidget *widget)
     {
         gdk_window_show (priv->event_window);
     }
+
+    if (!priv->media_loaded)
+    {
+        wb_util_track_viewport (&priv->lazy_image, GTK_WIDGET (self),
+                                G_CALLBACK (wb_image_button_maybe_load));
+        wb_image_button_maybe_load (self);
+    }
 }
 
 static void
@@ -408,27 +453,21 @@ wb_image_button_unmap (GtkWidget *widget)
         gdk_window_hide (priv->event_window);
     }
 
+    /* Don't spend bandwidth on images which are not shown anymore. */
+    wb_util_cancel_image (&priv->lazy_image);
+
     GTK_WIDGET_CLASS (wb_image_button_parent_class)->unmap (widget);
 }
 
 static void
-wb_image_button_constructed (GObject *object)
+wb_image_button_dispose (GObject *object)
 {
-    gchar *mq_uri;
-    SoupMessage *msg;
     WbImageButton *self = WB_IMAGE_BUTTON (object);
     WbImageButtonPrivate *priv = wb_image_button_get_instance_private (self);
 
-    /* Scale middle quality image as thumbnail */
-    mq_uri = wb_util_thumbnail_to_middle (priv->uri);
-
-    msg = soup_message_new (SOUP_METHOD_GET, mq_uri);
-    soup_session_queue_message (SOUPSESSION, msg,
-                                on_message_complete, self);
-
-    g_free (mq_uri);
+    wb_util_cancel_image (&priv->lazy_image);
 
-    G_OBJECT_CLASS (wb_image_button_parent_class)->constructed (object);
+    G_OBJECT_CLASS (wb_image_button_parent_class)->dispose (object);
 }
 
 static void
@@ -438,13 +477,10 @@ wb_image_button_finalize (GObject *object)
     WbImageButtonPrivate *priv = wb_image_button_get_instance_private (self);
 
     g_free (priv->uri);
-    if (priv->pixbuf != NULL)
+    /* Let the cache drop the image once nothing shows it. */
+    if (priv->surface != NULL)
     {
-        g_object_unref (priv->pixbuf);
-    }
-    if (priv->scaled_pixbuf != NULL)
-    {
-        g_object_unref (priv->scaled_pixbuf);
+        cairo_surface_destroy (priv->surface);
     }
 
     G_OBJECT_CLASS (wb_image_button_parent_class)->finalize (object);
@@ -519,7 +555,7 @@ wb_image_button_class_init (WbImageButtonClass *klass)
 		GObjectClass *object_class = G_OBJECT_CLASS (klass);
     GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
-    object_class->constructed = wb_image_button_constructed;
+    object_class->dispose = wb_image_button_dispose;
 		object_class->finalize = wb_image_button_finalize;
 		object_class->get_property = wb_image_button_get_property;
 		object_class->set_property = wb_image_button_set_property;
@@ -597,12 +633,17 @@ wb_image_button_init (WbImageButton *self)
     priv = wb_image_button_get_instance_private (self);
 
     priv->event_window = NULL;
+    priv->lazy_image.vadjustment = NULL;
+    priv->lazy_image.value_changed_id = 0;
+    priv->lazy_image.cancellable = NULL;
+    priv->lazy_image.priority = WB_IMAGE_PRIORITY_PREFETCH;
     priv->media_loaded = FALSE;
     priv->uri = NULL;
-    priv->pixbuf = NULL;
-    priv->scaled_pixbuf = NULL;
     priv->surface = NULL;
     priv->layout = gtk_widget_create_pango_layout (GTK_WIDGET (self), "...");
+
+    g_signal_connect (self, "notify::scale-factor",
+                      G_CALLBACK (scale_factor_changed_cb), NULL);
 }
 
 /**
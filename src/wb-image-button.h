@@ -36,7 +36,6 @@ G_DECLARE_FINAL_TYPE (WbImageButton, wb_image_button, WB, IMAGE_BUTTON, GtkWidge
 
 gint wb_image_button_get_nth_media (WbImageButton *image_button);
 WbMediaType wb_image_button_get_media_type (WbImageButton *image_button);
-GdkPixbuf *wb_image_button_get_pixbuf (WbImageButton *image_button);
 WbImageButton *wb_image_button_new (WbMediaType type,
                                     const gchar *uri,
                                     gint nth_media,
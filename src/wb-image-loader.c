@@ -0,0 +1,1259 @@
+/*
+ *  Weibird - View and compose weibo
+ *  Copyright (C) 2019 Jonathan Kang <jonathankang@gnome.org>.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+#include <string.h>
+
+#include "wb-image-loader.h"
+#include "wb-util.h"
+
+#define N_PRIORITIES (WB_IMAGE_PRIORITY_PREFETCH + 1)
+
+/* Requests of all the classes but WB_IMAGE_PRIORITY_ORIGINAL share this
+ * many connections, so that an image the user asked for never has to
+ * wait for the timeline. */
+#define MAX_SHARED_RUNNING 8
+
+static const guint max_running[N_PRIORITIES] = {
+    2, /* WB_IMAGE_PRIORITY_ORIGINAL */
+    6, /* WB_IMAGE_PRIORITY_THUMBNAIL */
+    4, /* WB_IMAGE_PRIORITY_AVATAR */
+    2  /* WB_IMAGE_PRIORITY_PREFETCH */
+};
+
+static const SoupMessagePriority message_priorities[N_PRIORITIES] = {
+    SOUP_MESSAGE_PRIORITY_VERY_HIGH,
+    SOUP_MESSAGE_PRIORITY_HIGH,
+    SOUP_MESSAGE_PRIORITY_NORMAL,
+    SOUP_MESSAGE_PRIORITY_LOW
+};
+
+static const gchar SETTINGS_SCHEMA[] = "com.jonathankang.Weibird";
+static const gchar MEMORY_CACHE_SIZE[] = "memory-cache-size";
+
+#define PREMULTIPLY(c, a) (((c) * (a) + 127) / 255)
+
+struct _WbImageLoader
+{
+    GObject parent_instance;
+};
+
+typedef struct
+{
+    /* Jobs waiting for a free connection, one queue per class. */
+    GQueue queues[N_PRIORITIES];
+    guint n_running[N_PRIORITIES];
+    guint n_shared_running;
+    /* uri → WbImageJob, one job per image being downloaded. */
+    GHashTable *jobs;
+    /* GCancellable → WbImageWaiter */
+    GHashTable *waiters;
+    /* Decoded images, the most recently used first. */
+    GHashTable *cache;
+    GQueue lru;
+    gsize cache_size;
+    gsize max_cache_size;
+    GSettings *settings;
+} WbImageLoaderPrivate;
+
+typedef struct
+{
+    /* Embedded link of WbImageLoaderPrivate.lru */
+    GList link;
+    gchar *key;
+    cairo_surface_t *surface;
+    gsize size;
+} WbImageCacheEntry;
+
+/* A download, shared by every caller asking for the same uri. */
+typedef struct
+{
+    gchar *uri;
+    GList *waiters;
+    SoupMessage *msg;
+    /* Downloaded, being decoded in a worker thread. */
+    gboolean decoding;
+    GBytes *bytes;
+    WbImageLoader *loader;
+    WbImagePriority priority;
+    /* The class whose slot the job occupies while running. */
+    WbImagePriority running_priority;
+} WbImageJob;
+
+/* A size to prepare in a worker thread. */
+typedef struct
+{
+    gchar *key;
+    /* In device pixels. */
+    gint width;
+    gint height;
+    gint scale_factor;
+    cairo_surface_t *surface;
+    WbImageScaleMode mode;
+} WbImageTarget;
+
+typedef struct
+{
+    GBytes *bytes;
+    GPtrArray *targets;
+} WbImageDecodeData;
+
+/* A caller of wb_image_loader_load_async(). */
+typedef struct
+{
+    gchar *key;
+    gint width;
+    gint height;
+    gint scale_factor;
+    gulong cancelled_id;
+    GTask *task;
+    WbImageJob *job;
+    WbImagePriority priority;
+    WbImageScaleMode mode;
+} WbImageWaiter;
+
+G_DEFINE_TYPE_WITH_PRIVATE (WbImageLoader, wb_image_loader, G_TYPE_OBJECT)
+
+static void wb_image_loader_dispatch (WbImageLoader *self);
+
+static void
+wb_image_job_free (WbImageJob *job)
+{
+    g_free (job->uri);
+    if (job->bytes != NULL)
+    {
+        g_bytes_unref (job->bytes);
+    }
+    g_slice_free (WbImageJob, job);
+}
+
+static void
+wb_image_target_free (WbImageTarget *target)
+{
+    g_free (target->key);
+    if (target->surface != NULL)
+    {
+        cairo_surface_destroy (target->surface);
+    }
+    g_slice_free (WbImageTarget, target);
+}
+
+static void
+wb_image_decode_data_free (WbImageDecodeData *data)
+{
+    g_bytes_unref (data->bytes);
+    g_ptr_array_unref (data->targets);
+    g_slice_free (WbImageDecodeData, data);
+}
+
+static void
+wb_image_waiter_free (WbImageWaiter *waiter)
+{
+    GCancellable *cancellable;
+
+    cancellable = g_task_get_cancellable (waiter->task);
+    g_signal_handler_disconnect (cancellable, waiter->cancelled_id);
+
+    g_free (waiter->key);
+    g_object_unref (waiter->task);
+    g_slice_free (WbImageWaiter, waiter);
+}
+
+static void
+wb_image_cache_entry_free (WbImageCacheEntry *entry)
+{
+    g_free (entry->key);
+    cairo_surface_destroy (entry->surface);
+    g_slice_free (WbImageCacheEntry, entry);
+}
+
+static gchar *
+wb_image_loader_cache_key (const gchar *uri,
+                           gint width,
+                           gint height,
+                           gint scale_factor,
+                           WbImageScaleMode mode)
+{
+    return g_strdup_printf ("%dx%d@%d:%d:%s", width, height, scale_factor,
+                            mode, uri);
+}
+
+/* Drop the least recently used images until the cache fits in its
+ * budget. Images which are still shown by a widget are kept, dropping
+ * them wouldn't free any memory and they would be decoded again the
+ * next time they are asked for. */
+static void
+wb_image_loader_trim_cache (WbImageLoader *self)
+{
+    GList *l;
+    WbImageLoaderPrivate *priv = wb_image_loader_get_instance_private (self);
+
+    l = priv->lru.tail;
+    while (l != NULL && priv->cache_size > priv->max_cache_size)
+    {
+        WbImageCacheEntry *entry = l->data;
+
+        l = l->prev;
+
+        if (cairo_surface_get_reference_count (entry->surface) > 1)
+        {
+            continue;
+        }
+
+        g_queue_unlink (&priv->lru, &entry->link);
+        priv->cache_size -= entry->size;
+        g_hash_table_remove (priv->cache, entry->key);
+    }
+}
+
+static cairo_surface_t *
+wb_image_loader_cache_lookup (WbImageLoader *self,
+                              const gchar *key)
+{
+    WbImageCacheEntry *entry;
+    WbImageLoaderPrivate *priv = wb_image_loader_get_instance_private (self);
+
+    entry = g_hash_table_lookup (priv->cache, key);
+    if (entry == NULL)
+    {
+        return NULL;
+    }
+
+    g_queue_unlink (&priv->lru, &entry->link);
+    g_queue_push_head_link (&priv->lru, &entry->link);
+
+    return cairo_surface_reference (entry->surface);
+}
+
+static void
+wb_image_loader_cache_insert (WbImageLoader *self,
+                              const gchar *key,
+                              cairo_surface_t *surface)
+{
+    WbImageCacheEntry *entry;
+    WbImageLoaderPrivate *priv = wb_image_loader_get_instance_private (self);
+
+    entry = g_slice_new0 (WbImageCacheEntry);
+    entry->link.data = entry;
+    entry->key = g_strdup (key);
+    entry->surface = cairo_surface_reference (surface);
+    entry->size = cairo_image_surface_get_stride (surface) *
+                  cairo_image_surface_get_height (surface);
+
+    g_hash_table_insert (priv->cache, entry->key, entry);
+    g_queue_push_head_link (&priv->lru, &entry->link);
+    priv->cache_size += entry->size;
+}
+
+/* Scale @pixbuf to the size a widget asked for. */
+static GdkPixbuf *
+wb_image_loader_scale_pixbuf (GdkPixbuf *pixbuf,
+                              gint width,
+                              gint height,
+                              WbImageScaleMode mode)
+{
+    gdouble scale;
+    gdouble offset_x, offset_y;
+    gint pixbuf_width;
+    gint pixbuf_height;
+    GdkPixbuf *scaled_pixbuf;
+
+    pixbuf_width = gdk_pixbuf_get_width (pixbuf);
+    pixbuf_height = gdk_pixbuf_get_height (pixbuf);
+
+    switch (mode)
+    {
+        case WB_IMAGE_SCALE_CROP:
+            if (pixbuf_width == width && pixbuf_height == height)
+            {
+                return g_object_ref (pixbuf);
+            }
+
+            /* If the image is large enough, cropped the central part
+             * of the image and scale it down */
+            if (pixbuf_width >= width && pixbuf_height >= height)
+            {
+                scaled_pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB,
+                                                gdk_pixbuf_get_has_alpha (pixbuf),
+                                                8, width, height);
+
+                scale = MAX ((gdouble) width / pixbuf_width,
+                             (gdouble) height / pixbuf_height);
+                offset_x = (pixbuf_width * scale - width) / -2;
+                offset_y = (pixbuf_height * scale - height) / -2;
+
+                gdk_pixbuf_scale (pixbuf, scaled_pixbuf,
+                                  0, 0, width, height,
+                                  offset_x, offset_y, scale, scale,
+                                  GDK_INTERP_BILINEAR);
+
+                return scaled_pixbuf;
+            }
+
+            return gdk_pixbuf_scale_simple (pixbuf, width, height,
+                                            GDK_INTERP_BILINEAR);
+        case WB_IMAGE_SCALE_FIT:
+            if (pixbuf_width > width && pixbuf_height > height)
+            {
+                scale = MIN ((gdouble) width / pixbuf_width,
+                             (gdouble) height / pixbuf_height);
+
+                return gdk_pixbuf_scale_simple (pixbuf,
+                                                MAX (pixbuf_width * scale, 1),
+                                                MAX (pixbuf_height * scale, 1),
+                                                GDK_INTERP_BILINEAR);
+            }
+
+            return g_object_ref (pixbuf);
+        case WB_IMAGE_SCALE_NONE:
+        default:
+            return g_object_ref (pixbuf);
+    }
+}
+
+/* Same as gdk_cairo_surface_create_from_pixbuf(), which must not be
+ * used outside of the main thread. */
+static cairo_surface_t *
+wb_image_loader_surface_from_pixbuf (GdkPixbuf *pixbuf)
+{
+    const guchar *pixels;
+    guchar *data;
+    gint n_channels;
+    gint rowstride;
+    gint stride;
+    gint width, height;
+    gint x, y;
+    cairo_surface_t *surface;
+
+    n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+    rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+    width = gdk_pixbuf_get_width (pixbuf);
+    height = gdk_pixbuf_get_height (pixbuf);
+    pixels = gdk_pixbuf_read_pixels (pixbuf);
+
+    surface = cairo_image_surface_create (n_channels == 3 ? CAIRO_FORMAT_RGB24
+                                                          : CAIRO_FORMAT_ARGB32,
+                                          width, height);
+    if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
+    {
+        return surface;
+    }
+
+    cairo_surface_flush (surface);
+    data = cairo_image_surface_get_data (surface);
+    stride = cairo_image_surface_get_stride (surface);
+
+    for (y = 0; y < height; y++)
+    {
+        const guchar *p = pixels + y * rowstride;
+        guint32 *q = (guint32 *) (data + y * stride);
+
+        for (x = 0; x < width; x++, p += n_channels)
+        {
+            if (n_channels == 3)
+            {
+                q[x] = 0xff000000 | p[0] << 16 | p[1] << 8 | p[2];
+            }
+            else
+            {
+                /* Cairo expects premultiplied alpha. */
+                q[x] = (guint32) p[3] << 24 |
+                       PREMULTIPLY (p[0], p[3]) << 16 |
+                       PREMULTIPLY (p[1], p[3]) << 8 |
+                       PREMULTIPLY (p[2], p[3]);
+            }
+        }
+    }
+
+    cairo_surface_mark_dirty (surface);
+
+    return surface;
+}
+
+static cairo_surface_t *
+wb_image_loader_create_surface (GdkPixbuf *pixbuf,
+                                gint width,
+                                gint height,
+                                gint scale_factor,
+                                WbImageScaleMode mode)
+{
+    cairo_surface_t *surface;
+    GdkPixbuf *scaled_pixbuf;
+
+    scaled_pixbuf = wb_image_loader_scale_pixbuf (pixbuf, width, height, mode);
+
+    surface = wb_image_loader_surface_from_pixbuf (scaled_pixbuf);
+    /* Painted at its logical size, without being scaled again. */
+    cairo_surface_set_device_scale (surface, scale_factor, scale_factor);
+    /* Only the surface is kept, it is the format the image is drawn
+     * in. */
+    g_object_unref (scaled_pixbuf);
+
+    return surface;
+}
+
+/* The job runs with the priority of its most important waiter. */
+static void
+wb_image_loader_update_job_priority (WbImageLoader *self,
+                                     WbImageJob *job)
+{
+    GList *l;
+    WbImagePriority priority;
+    WbImageLoaderPrivate *priv = wb_image_loader_get_instance_private (self);
+
+    priority = WB_IMAGE_PRIORITY_PREFETCH;
+    for (l = job->waiters; l != NULL; l = l->next)
+    {
+        WbImageWaiter *waiter = l->data;
+
+        priority = MIN (priority, waiter->priority);
+    }
+
+    if (priority == job->priority)
+    {
+        return;
+    }
+
+    /* A job which is already running keeps its connection. */
+    if (job->msg != NULL)
+    {
+        soup_message_set_priority (job->msg, message_priorities[priority]);
+    }
+    else if (!job->decoding)
+    {
+        g_queue_remove (&priv->queues[job->priority], job);
+        g_queue_push_tail (&priv->queues[priority], job);
+    }
+
+    job->priority = priority;
+}
+
+/* Hand the cached images, or @error if it is set, to every waiter of
+ * @job and free it. */
+static void
+wb_image_loader_complete_job (WbImageLoader *self,
+                              WbImageJob *job,
+                              const GError *error)
+{
+    GList *waiters;
+    GList *l;
+    WbImageLoaderPrivate *priv = wb_image_loader_get_instance_private (self);
+
+    if (g_hash_table_lookup (priv->jobs, job->uri) == job)
+    {
+        g_hash_table_remove (priv->jobs, job->uri);
+    }
+
+    /* Returning a task may run its callback right away, which could
+     * queue or cancel other requests. Detach the waiters first. */
+    waiters = job->waiters;
+    job->waiters = NULL;
+
+    for (l = waiters; l != NULL; l = l->next)
+    {
+        WbImageWaiter *waiter = l->data;
+
+        g_hash_table_remove (priv->waiters,
+                             g_task_get_cancellable (waiter->task));
+        waiter->job = NULL;
+    }
+
+    for (l = waiters; l != NULL; l = l->next)
+    {
+        WbImageWaiter *waiter = l->data;
+
+        if (g_task_return_error_if_cancelled (waiter->task))
+        {
+            /* Nothing to do. */
+        }
+        else if (error != NULL)
+        {
+            g_task_return_error (waiter->task, g_error_copy (error));
+        }
+        else
+        {
+            cairo_surface_t *surface;
+
+            /* Widgets showing the image at the same size share the
+             * surface. */
+            surface = wb_image_loader_cache_lookup (self, waiter->key);
+            if (surface != NULL)
+            {
+                g_task_return_pointer (waiter->task, surface,
+                                       (GDestroyNotify) cairo_surface_destroy);
+            }
+            else
+            {
+                g_task_return_new_error (waiter->task, G_IO_ERROR,
+                                         G_IO_ERROR_FAILED,
+                                         "Failed to prepare %s", job->uri);
+            }
+        }
+
+        wb_image_waiter_free (waiter);
+    }
+
+    g_list_free (waiters);
+    wb_image_job_free (job);
+
+    wb_image_loader_trim_cache (self);
+}
+
+/* The factor an image of @width by @height has to be scaled by to
+ * produce @target. */
+static gdouble
+wb_image_target_get_scale (WbImageTarget *target,
+                           gint width,
+                           gint height)
+{
+    switch (target->mode)
+    {
+        case WB_IMAGE_SCALE_CROP:
+            return MAX ((gdouble) target->width / width,
+                        (gdouble) target->height / height);
+        case WB_IMAGE_SCALE_FIT:
+            if (width <= target->width || height <= target->height)
+            {
+                return 1.0;
+            }
+
+            return MIN ((gdouble) target->width / width,
+                        (gdouble) target->height / height);
+        case WB_IMAGE_SCALE_NONE:
+        default:
+            return 1.0;
+    }
+}
+
+static void
+size_prepared_cb (GdkPixbufLoader *loader,
+                  gint width,
+                  gint height,
+                  gpointer user_data)
+{
+    guint i;
+    gdouble scale = 0.0;
+    WbImageDecodeData *data = user_data;
+
+    for (i = 0; i < data->targets->len; i++)
+    {
+        WbImageTarget *target = g_ptr_array_index (data->targets, i);
+
+        scale = MAX (scale, wb_image_target_get_scale (target, width, height));
+    }
+
+    /* Let the loader produce the smallest image all the targets can be
+     * cropped from, so that the full size image is never allocated. The
+     * JPEG loader decodes straight to a fraction of the size. */
+    if (scale > 0.0 && scale < 1.0)
+    {
+        gdouble scaled_width = width * scale;
+        gdouble scaled_height = height * scale;
+
+        /* Round up, the targets must not be upscaled. */
+        gdk_pixbuf_loader_set_size (loader,
+                                    MAX ((gint) scaled_width + (scaled_width > (gint) scaled_width), 1),
+                                    MAX ((gint) scaled_height + (scaled_height > (gint) scaled_height), 1));
+    }
+}
+
+static void
+decode_thread (GTask *task,
+               gpointer source_object,
+               gpointer task_data,
+               GCancellable *cancellable)
+{
+    guint i;
+    GdkPixbuf *pixbuf;
+    GdkPixbufLoader *loader;
+    GError *error = NULL;
+    WbImageDecodeData *data = task_data;
+
+    if (data->targets->len == 0)
+    {
+        g_task_return_boolean (task, TRUE);
+
+        return;
+    }
+
+    /* Decode only once, however many widgets show the image. */
+    loader = gdk_pixbuf_loader_new ();
+    g_signal_connect (loader, "size-prepared",
+                      G_CALLBACK (size_prepared_cb), data);
+
+    if (!gdk_pixbuf_loader_write_bytes (loader, data->bytes, &error))
+    {
+        gdk_pixbuf_loader_close (loader, NULL);
+        g_object_unref (loader);
+        g_task_return_error (task, error);
+
+        return;
+    }
+
+    if (!gdk_pixbuf_loader_close (loader, &error))
+    {
+        g_object_unref (loader);
+        g_task_return_error (task, error);
+
+        return;
+    }
+
+    pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+    if (pixbuf == NULL)
+    {
+        g_object_unref (loader);
+        g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                 "Unable to create pixbuf");
+
+        return;
+    }
+
+    for (i = 0; i < data->targets->len; i++)
+    {
+        WbImageTarget *target = g_ptr_array_index (data->targets, i);
+
+        target->surface = wb_image_loader_create_surface (pixbuf,
+                                                          target->width,
+                                                          target->height,
+                                                          target->scale_factor,
+                                                          target->mode);
+    }
+
+    g_object_unref (loader);
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static void wb_image_loader_decode (WbImageLoader *self,
+                                    WbImageJob *job);
+
+static void
+decode_finished_cb (GObject *source_object,
+                    GAsyncResult *result,
+                    gpointer user_data)
+{
+    guint i;
+    GList *l;
+    GError *error = NULL;
+    WbImageDecodeData *data;
+    WbImageJob *job = user_data;
+    WbImageLoader *self = WB_IMAGE_LOADER (source_object);
+    WbImageLoaderPrivate *priv = wb_image_loader_get_instance_private (self);
+
+    data = g_task_get_task_data (G_TASK (result));
+
+    if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+        wb_image_loader_complete_job (self, job, error);
+        g_error_free (error);
+
+        return;
+    }
+
+    for (i = 0; i < data->targets->len; i++)
+    {
+        WbImageTarget *target = g_ptr_array_index (data->targets, i);
+
+        if (!g_hash_table_contains (priv->cache, target->key))
+        {
+            wb_image_loader_cache_insert (self, target->key, target->surface);
+        }
+    }
+
+    /* Waiters which joined while decoding may want other sizes. */
+    for (l = job->waiters; l != NULL; l = l->next)
+    {
+        WbImageWaiter *waiter = l->data;
+
+        if (!g_hash_table_contains (priv->cache, waiter->key))
+        {
+            wb_image_loader_decode (self, job);
+
+            return;
+        }
+    }
+
+    wb_image_loader_complete_job (self, job, NULL);
+}
+
+/* Decode the downloaded image and prepare the sizes the waiters of
+ * @job asked for, in a worker thread. */
+static void
+wb_image_loader_decode (WbImageLoader *self,
+                        WbImageJob *job)
+{
+    GList *l;
+    GTask *task;
+    WbImageDecodeData *data;
+    WbImageLoaderPrivate *priv = wb_image_loader_get_instance_private (self);
+
+    data = g_slice_new0 (WbImageDecodeData);
+    data->bytes = g_bytes_ref (job->bytes);
+    data->targets = g_ptr_array_new_with_free_func ((GDestroyNotify) wb_image_target_free);
+
+    for (l = job->waiters; l != NULL; l = l->next)
+    {
+        guint i;
+        gboolean found = FALSE;
+        WbImageWaiter *waiter = l->data;
+
+        if (g_hash_table_contains (priv->cache, waiter->key))
+        {
+            continue;
+        }
+
+        for (i = 0; i < data->targets->len && !found; i++)
+        {
+            WbImageTarget *target = g_ptr_array_index (data->targets, i);
+
+            found = g_strcmp0 (target->key, waiter->key) == 0;
+        }
+
+        if (!found)
+        {
+            WbImageTarget *target;
+
+            target = g_slice_new0 (WbImageTarget);
+            target->key = g_strdup (waiter->key);
+            target->width = waiter->width * waiter->scale_factor;
+            target->height = waiter->height * waiter->scale_factor;
+            target->scale_factor = waiter->scale_factor;
+            target->mode = waiter->mode;
+            g_ptr_array_add (data->targets, target);
+        }
+    }
+
+    job->decoding = TRUE;
+
+    task = g_task_new (self, NULL, decode_finished_cb, job);
+    g_task_set_task_data (task, data,
+                          (GDestroyNotify) wb_image_decode_data_free);
+    g_task_run_in_thread (task, decode_thread);
+    g_object_unref (task);
+}
+
+static void
+on_message_complete (SoupSession *session,
+                     SoupMessage *msg,
+                     gpointer user_data)
+{
+    GError *error = NULL;
+    WbImageJob *job = user_data;
+    WbImageLoader *self;
+    WbImageLoaderPrivate *priv;
+
+    self = job->loader;
+    priv = wb_image_loader_get_instance_private (self);
+
+    priv->n_running[job->running_priority]--;
+    if (job->running_priority != WB_IMAGE_PRIORITY_ORIGINAL)
+    {
+        priv->n_shared_running--;
+    }
+    job->msg = NULL;
+
+    if (msg->status_code == SOUP_STATUS_CANCELLED)
+    {
+        g_set_error (&error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                     "Loading %s was cancelled", job->uri);
+    }
+    else if (!SOUP_STATUS_IS_SUCCESSFUL (msg->status_code))
+    {
+        g_set_error (&error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "Failed to get %s: %d %s", job->uri,
+                     msg->status_code, msg->reason_phrase);
+    }
+
+    if (error != NULL)
+    {
+        wb_image_loader_complete_job (self, job, error);
+        g_error_free (error);
+    }
+    else
+    {
+        SoupBuffer *buffer;
+
+        /* Keep the main thread free for drawing. The encoded image is
+         * kept, in case waiters joining later want other sizes. */
+        buffer = soup_message_body_flatten (msg->response_body);
+        job->bytes = soup_buffer_get_as_bytes (buffer);
+        soup_buffer_free (buffer);
+
+        wb_image_loader_decode (self, job);
+    }
+
+    wb_image_loader_dispatch (self);
+    g_object_unref (self);
+}
+
+static void
+cancelled_cb (GCancellable *cancellable,
+              gpointer user_data)
+{
+    WbImageJob *job;
+    WbImageLoader *self;
+    WbImageLoaderPrivate *priv;
+    WbImageWaiter *waiter = user_data;
+
+    self = WB_IMAGE_LOADER (g_task_get_source_object (waiter->task));
+    priv = wb_image_loader_get_instance_private (self);
+    job = waiter->job;
+
+    /* The job is being completed, the waiter will be handled there. */
+    if (job == NULL)
+    {
+        return;
+    }
+
+    g_hash_table_remove (priv->waiters, cancellable);
+    job->waiters = g_list_remove (job->waiters, waiter);
+
+    g_task_return_error_if_cancelled (waiter->task);
+    wb_image_waiter_free (waiter);
+
+    if (job->waiters != NULL)
+    {
+        wb_image_loader_update_job_priority (self, job);
+    }
+    else if (job->msg != NULL)
+    {
+        /* Nobody is interested in the image anymore, on_message_complete()
+         * takes care of the rest. New requests for the same uri must not
+         * join the aborted job. */
+        g_hash_table_remove (priv->jobs, job->uri);
+        soup_session_cancel_message (SOUPSESSION, job->msg,
+                                     SOUP_STATUS_CANCELLED);
+    }
+    else if (job->decoding)
+    {
+        /* The image is downloaded already, let the worker finish and
+         * keep the result in the cache. */
+    }
+    else
+    {
+        g_queue_remove (&priv->queues[job->priority], job);
+        g_hash_table_remove (priv->jobs, job->uri);
+        wb_image_job_free (job);
+    }
+}
+
+static void
+wb_image_loader_start (WbImageLoader *self,
+                       WbImageJob *job)
+{
+    GError *error = NULL;
+    WbImageLoaderPrivate *priv = wb_image_loader_get_instance_private (self);
+
+    job->msg = soup_message_new (SOUP_METHOD_GET, job->uri);
+    if (job->msg == NULL || SOUPSESSION == NULL)
+    {
+        g_clear_object (&job->msg);
+        g_set_error (&error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "Unable to load %s", job->uri);
+        wb_image_loader_complete_job (self, job, error);
+        g_error_free (error);
+
+        return;
+    }
+
+    job->running_priority = job->priority;
+    priv->n_running[job->priority]++;
+    if (job->priority != WB_IMAGE_PRIORITY_ORIGINAL)
+    {
+        priv->n_shared_running++;
+    }
+
+    /* The loader must outlive the message, the reference is dropped in
+     * on_message_complete(). */
+    job->loader = g_object_ref (self);
+
+    soup_message_set_priority (job->msg, message_priorities[job->priority]);
+    /* The session holds the only reference to the message. */
+    soup_session_queue_message (SOUPSESSION, job->msg,
+                                on_message_complete, job);
+}
+
+/* Start as many queued jobs as the limits allow, the most important
+ * classes first. */
+static void
+wb_image_loader_dispatch (WbImageLoader *self)
+{
+    gint i;
+    WbImageLoaderPrivate *priv = wb_image_loader_get_instance_private (self);
+
+    for (i = 0; i < N_PRIORITIES; i++)
+    {
+        while (!g_queue_is_empty (&priv->queues[i]) &&
+               priv->n_running[i] < max_running[i] &&
+               (i == WB_IMAGE_PRIORITY_ORIGINAL ||
+                priv->n_shared_running < MAX_SHARED_RUNNING))
+        {
+            wb_image_loader_start (self, g_queue_pop_head (&priv->queues[i]));
+        }
+    }
+}
+
+/**
+ * wb_image_loader_load_async:
+ * @self: a #WbImageLoader
+ * @uri: the uri of the image
+ * @width: the width to show the image at
+ * @height: the height to show the image at
+ * @scale_factor: the scale factor of the widget showing the image
+ * @mode: how to fit the image into @width and @height
+ * @priority: a #WbImagePriority
+ * @cancellable: a #GCancellable
+ * @callback: callback to call when the image is loaded
+ * @user_data: data to pass to @callback
+ *
+ * Load @uri and scale it to @width and @height, in application pixels.
+ * The returned surface has @scale_factor times as many pixels and the
+ * matching device scale, so that it is sharp on HiDPI screens. Images
+ * which were loaded before are returned from the memory cache.
+ *
+ * Downloads are started in the order of their priority, and only a
+ * limited number of them run at the same time. Requests for the same
+ * @uri share a single download, which is aborted once all of them are
+ * cancelled.
+ *
+ * @cancellable identifies the request in wb_image_loader_set_priority(),
+ * so it must not be shared between requests.
+ */
+void
+wb_image_loader_load_async (WbImageLoader *self,
+                            const gchar *uri,
+                            gint width,
+                            gint height,
+                            gint scale_factor,
+                            WbImageScaleMode mode,
+                            WbImagePriority priority,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data)
+{
+    gchar *key;
+    cairo_surface_t *surface;
+    GTask *task;
+    WbImageJob *job;
+    WbImageWaiter *waiter;
+    WbImageLoaderPrivate *priv;
+
+    g_return_if_fail (WB_IS_IMAGE_LOADER (self));
+    g_return_if_fail (uri != NULL);
+    g_return_if_fail (scale_factor >= 1);
+    g_return_if_fail (G_IS_CANCELLABLE (cancellable));
+
+    priv = wb_image_loader_get_instance_private (self);
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_source_tag (task, wb_image_loader_load_async);
+
+    if (g_task_return_error_if_cancelled (task))
+    {
+        g_object_unref (task);
+
+        return;
+    }
+
+    key = wb_image_loader_cache_key (uri, width, height, scale_factor, mode);
+    surface = wb_image_loader_cache_lookup (self, key);
+    if (surface != NULL)
+    {
+        g_task_return_pointer (task, surface,
+                               (GDestroyNotify) cairo_surface_destroy);
+        g_object_unref (task);
+        g_free (key);
+
+        return;
+    }
+
+    job = g_hash_table_lookup (priv->jobs, uri);
+    if (job == NULL)
+    {
+        job = g_slice_new0 (WbImageJob);
+        job->uri = g_strdup (uri);
+        job->loader = self;
+        job->priority = priority;
+
+        g_hash_table_insert (priv->jobs, job->uri, job);
+        g_queue_push_tail (&priv->queues[priority], job);
+    }
+
+    waiter = g_slice_new0 (WbImageWaiter);
+    waiter->key = key;
+    waiter->width = width;
+    waiter->height = height;
+    waiter->scale_factor = scale_factor;
+    waiter->mode = mode;
+    waiter->task = task;
+    waiter->job = job;
+    waiter->priority = priority;
+    waiter->cancelled_id = g_signal_connect (cancellable, "cancelled",
+                                             G_CALLBACK (cancelled_cb),
+                                             waiter);
+
+    job->waiters = g_list_prepend (job->waiters, waiter);
+    g_hash_table_insert (priv->waiters, cancellable, waiter);
+
+    wb_image_loader_update_job_priority (self, job);
+    wb_image_loader_dispatch (self);
+}
+
+/**
+ * wb_image_loader_load_finish:
+ * @self: a #WbImageLoader
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError
+ *
+ * The returned surface is shared by every request for the same image
+ * and size, it must not be modified.
+ *
+ * Returns: (transfer full): the image, or %NULL on error
+ */
+cairo_surface_t *
+wb_image_loader_load_finish (WbImageLoader *self,
+                             GAsyncResult *result,
+                             GError **error)
+{
+    g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+    g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) ==
+                          wb_image_loader_load_async, NULL);
+
+    return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/**
+ * wb_image_loader_set_priority:
+ * @self: a #WbImageLoader
+ * @cancellable: the #GCancellable the request was queued with
+ * @priority: the new #WbImagePriority
+ *
+ * Move a request to another class, for instance when the image
+ * scrolled into or out of the viewport. A request which is already
+ * running keeps its connection.
+ */
+void
+wb_image_loader_set_priority (WbImageLoader *self,
+                              GCancellable *cancellable,
+                              WbImagePriority priority)
+{
+    WbImageWaiter *waiter;
+    WbImageLoaderPrivate *priv;
+
+    g_return_if_fail (WB_IS_IMAGE_LOADER (self));
+    g_return_if_fail (G_IS_CANCELLABLE (cancellable));
+
+    priv = wb_image_loader_get_instance_private (self);
+
+    waiter = g_hash_table_lookup (priv->waiters, cancellable);
+    if (waiter == NULL || waiter->priority == priority)
+    {
+        return;
+    }
+
+    waiter->priority = priority;
+    wb_image_loader_update_job_priority (self, waiter->job);
+
+    wb_image_loader_dispatch (self);
+}
+
+/**
+ * wb_image_loader_lookup:
+ * @self: a #WbImageLoader
+ * @uri: the uri of the image
+ * @width: the width to show the image at
+ * @height: the height to show the image at
+ * @scale_factor: the scale factor of the widget showing the image
+ * @mode: how to fit the image into @width and @height
+ *
+ * Look up an image in the memory cache, without downloading it.
+ *
+ * Returns: (transfer full) (nullable): the image, or %NULL if it
+ * isn't cached
+ */
+cairo_surface_t *
+wb_image_loader_lookup (WbImageLoader *self,
+                        const gchar *uri,
+                        gint width,
+                        gint height,
+                        gint scale_factor,
+                        WbImageScaleMode mode)
+{
+    g_autofree gchar *key = NULL;
+
+    g_return_val_if_fail (WB_IS_IMAGE_LOADER (self), NULL);
+    g_return_val_if_fail (uri != NULL, NULL);
+
+    key = wb_image_loader_cache_key (uri, width, height, scale_factor, mode);
+
+    return wb_image_loader_cache_lookup (self, key);
+}
+
+/**
+ * wb_image_loader_foreach_cached:
+ * @self: a #WbImageLoader
+ * @uris: (element-type utf8 utf8): a set of uris
+ * @func: function to call with each image
+ * @user_data: data to pass to @func
+ *
+ * Call @func with every image of @uris in the memory cache, at any
+ * size, along with its cache key. The images can be put back later
+ * using wb_image_loader_add_cached().
+ */
+void
+wb_image_loader_foreach_cached (WbImageLoader *self,
+                                GHashTable *uris,
+                                WbImageLoaderForeachFunc func,
+                                gpointer user_data)
+{
+    GList *l;
+    WbImageLoaderPrivate *priv;
+
+    g_return_if_fail (WB_IS_IMAGE_LOADER (self));
+    g_return_if_fail (uris != NULL);
+    g_return_if_fail (func != NULL);
+
+    priv = wb_image_loader_get_instance_private (self);
+
+    /* The most recently used first. */
+    for (l = priv->lru.head; l != NULL; l = l->next)
+    {
+        const gchar *uri;
+        WbImageCacheEntry *entry = l->data;
+
+        /* See wb_image_loader_cache_key(), the uri comes after the
+         * size and the scale mode. */
+        uri = strchr (entry->key, ':');
+        uri = uri != NULL ? strchr (uri + 1, ':') : NULL;
+        if (uri != NULL && g_hash_table_contains (uris, uri + 1))
+        {
+            func (entry->key, entry->surface, user_data);
+        }
+    }
+}
+
+/**
+ * wb_image_loader_add_cached:
+ * @self: a #WbImageLoader
+ * @key: the cache key given by wb_image_loader_foreach_cached()
+ * @surface: the image, an image surface
+ *
+ * Put an image back in the memory cache, unless it is there already.
+ */
+void
+wb_image_loader_add_cached (WbImageLoader *self,
+                            const gchar *key,
+                            cairo_surface_t *surface)
+{
+    WbImageLoaderPrivate *priv;
+
+    g_return_if_fail (WB_IS_IMAGE_LOADER (self));
+    g_return_if_fail (key != NULL);
+    g_return_if_fail (cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_IMAGE);
+
+    priv = wb_image_loader_get_instance_private (self);
+
+    if (g_hash_table_contains (priv->cache, key))
+    {
+        return;
+    }
+
+    wb_image_loader_cache_insert (self, key, surface);
+    wb_image_loader_trim_cache (self);
+}
+
+static void
+settings_changed_cb (GSettings *settings,
+                     const gchar *key,
+                     gpointer user_data)
+{
+    WbImageLoader *self = WB_IMAGE_LOADER (user_data);
+    WbImageLoaderPrivate *priv = wb_image_loader_get_instance_private (self);
+
+    if (g_strcmp0 (key, MEMORY_CACHE_SIZE) == 0)
+    {
+        priv->max_cache_size = (gsize) g_settings_get_uint (settings, key)
+                               * 1024 * 1024;
+        wb_image_loader_trim_cache (self);
+    }
+}
+
+static void
+wb_image_loader_finalize (GObject *object)
+{
+    WbImageLoader *self = WB_IMAGE_LOADER (object);
+    WbImageLoaderPrivate *priv = wb_image_loader_get_instance_private (self);
+
+    g_hash_table_destroy (priv->jobs);
+    g_hash_table_destroy (priv->waiters);
+    g_hash_table_destroy (priv->cache);
+    g_object_unref (priv->settings);
+
+    G_OBJECT_CLASS (wb_image_loader_parent_class)->finalize (object);
+}
+
+static void
+wb_image_loader_class_init (WbImageLoaderClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->finalize = wb_image_loader_finalize;
+}
+
+static void
+wb_image_loader_init (WbImageLoader *self)
+{
+    gint i;
+    WbImageLoaderPrivate *priv = wb_image_loader_get_instance_private (self);
+
+    for (i = 0; i < N_PRIORITIES; i++)
+    {
+        g_queue_init (&priv->queues[i]);
+        priv->n_running[i] = 0;
+    }
+    priv->n_shared_running = 0;
+    priv->jobs = g_hash_table_new (g_str_hash, g_str_equal);
+    priv->waiters = g_hash_table_new (NULL, NULL);
+
+    priv->cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                         (GDestroyNotify) wb_image_cache_entry_free);
+    g_queue_init (&priv->lru);
+    priv->cache_size = 0;
+
+    priv->settings = g_settings_new (SETTINGS_SCHEMA);
+    priv->max_cache_size = (gsize) g_settings_get_uint (priv->settings,
+                                                        MEMORY_CACHE_SIZE)
+                           * 1024 * 1024;
+    g_signal_connect (priv->settings, "changed",
+                      G_CALLBACK (settings_changed_cb), self);
+}
+
+/**
+ * wb_image_loader_new:
+ *
+ * Create a new #WbImageLoader.
+ *
+ * Returns: (transfer full): a newly created #WbImageLoader
+ */
+WbImageLoader *
+wb_image_loader_new (void)
+{
+    return g_object_new (WB_TYPE_IMAGE_LOADER, NULL);
+}
@@ -0,0 +1,88 @@
+/*
+ *  Weibird - View and compose weibo
+ *  Copyright (C) 2019 Jonathan Kang <jonathankang@gnome.org>.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gio/gio.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/* Ordered from the most to the least important. */
+typedef enum
+{
+    WB_IMAGE_PRIORITY_ORIGINAL,
+    WB_IMAGE_PRIORITY_THUMBNAIL,
+    WB_IMAGE_PRIORITY_AVATAR,
+    WB_IMAGE_PRIORITY_PREFETCH
+} WbImagePriority;
+
+typedef enum
+{
+    /* Keep the size of the image. */
+    WB_IMAGE_SCALE_NONE,
+    /* Crop the central part of the image and fill the whole size. */
+    WB_IMAGE_SCALE_CROP,
+    /* Scale the image down until it fits in the size, if it is both
+     * wider and taller. Long images are kept readable. */
+    WB_IMAGE_SCALE_FIT
+} WbImageScaleMode;
+
+/* Called with each cached image, see wb_image_loader_foreach_cached(). */
+typedef void (*WbImageLoaderForeachFunc) (const gchar *key,
+                                          cairo_surface_t *surface,
+                                          gpointer user_data);
+
+#define WB_TYPE_IMAGE_LOADER (wb_image_loader_get_type ())
+
+G_DECLARE_FINAL_TYPE (WbImageLoader, wb_image_loader, WB, IMAGE_LOADER, GObject)
+
+void wb_image_loader_load_async (WbImageLoader *self,
+                                 const gchar *uri,
+                                 gint width,
+                                 gint height,
+                                 gint scale_factor,
+                                 WbImageScaleMode mode,
+                                 WbImagePriority priority,
+                                 GCancellable *cancellable,
+                                 GAsyncReadyCallback callback,
+                                 gpointer user_data);
+cairo_surface_t *wb_image_loader_load_finish (WbImageLoader *self,
+                                              GAsyncResult *result,
+                                              GError **error);
+cairo_surface_t *wb_image_loader_lookup (WbImageLoader *self,
+                                         const gchar *uri,
+                                         gint width,
+                                         gint height,
+                                         gint scale_factor,
+                                         WbImageScaleMode mode);
+void wb_image_loader_set_priority (WbImageLoader *self,
+                                   GCancellable *cancellable,
+                                   WbImagePriority priority);
+void wb_image_loader_foreach_cached (WbImageLoader *self,
+                                     GHashTable *uris,
+                                     WbImageLoaderForeachFunc func,
+                                     gpointer user_data);
+void wb_image_loader_add_cached (WbImageLoader *self,
+                                 const gchar *key,
+                                 cairo_surface_t *surface);
+WbImageLoader *wb_image_loader_new (void);
+
+G_END_DECLS
@@ -19,6 +19,8 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gtk/gtk.h>
 
+#include "wb-application.h"
+#include "wb-image-loader.h"
 #include "wb-media-dialog.h"
 #include "wb-util.h"
 
@@ -29,8 +31,9 @@ struct _WbMediaDialog
 
 typedef struct
 {
-    const GArray *pic_uris;
+    WbTweetItem *tweet_item;
     gint nth_media;
+    GCancellable *cancellable;
     GtkWidget *cur_image;
     GtkWidget *frame;
     GtkWidget *scrolled;
@@ -42,9 +45,9 @@ G_DEFINE_TYPE_WITH_PRIVATE (WbMediaDialog, wb_media_dialog, GTK_TYPE_WINDOW)
 
 static void change_media (WbMediaDialog *media_dialog,
                           gboolean previous);
-static void on_message_complete (SoupSession *session,
-                                 SoupMessage *msg,
-                                 gpointer user_data);
+static void image_loaded_cb (GObject *source_object,
+                             GAsyncResult *result,
+                             gpointer user_data);
 
 GtkWidget *
 wb_media_dialog_get_frame (WbMediaDialog *self)
@@ -115,16 +118,29 @@ leave_notify_event_cb (GtkWidget *widget,
 }
 
 static void
-wb_media_dialog_download_original_image (WbMediaDialog *self,
-                                         const gchar *thumbnail_uri)
+wb_media_dialog_download_original_image (WbMediaDialog *self)
 {
     gchar *original_uri;
-    SoupMessage *msg;
+    WbImageLoader *loader;
+    WbMediaDialogPrivate *priv = wb_media_dialog_get_instance_private (self);
+
+    /* Only the image being shown is worth downloading. */
+    if (priv->cancellable != NULL)
+    {
+        g_cancellable_cancel (priv->cancellable);
+        g_object_unref (priv->cancellable);
+    }
+    priv->cancellable = g_cancellable_new ();
 
-    original_uri = wb_util_thumbnail_to_original (thumbnail_uri);
-    msg = soup_message_new (SOUP_METHOD_GET, original_uri);
-    soup_session_queue_message (SOUPSESSION, msg,
-                                on_message_complete, self);
+    loader = wb_application_get_image_loader (WB_APPLICATION (g_application_get_default ()));
+    original_uri = wb_tweet_item_get_picture_uri (priv->tweet_item,
+                                                  priv->nth_media - 1,
+                                                  WB_PICTURE_SIZE_LARGE);
+    /* Scale the image a bit so that it's not too large */
+    wb_image_loader_load_async (loader, original_uri, MAX_WIDTH, MAX_HEIGHT,
+                                gtk_widget_get_scale_factor (GTK_WIDGET (self)),
+                                WB_IMAGE_SCALE_FIT, WB_IMAGE_PRIORITY_ORIGINAL,
+                                priv->cancellable, image_loaded_cb, self);
 
     g_free (original_uri);
 }
@@ -133,7 +149,6 @@ static void
 change_media (WbMediaDialog *media_dialog,
               gboolean previous)
 {
-    const gchar *thumbnail_uri;
     WbMediaDialogPrivate *priv;
 
     priv = wb_media_dialog_get_instance_private (media_dialog);
@@ -142,22 +157,26 @@ change_media (WbMediaDialog *media_dialog,
     {
         return;
     }
-    else if (!previous && priv->nth_media == priv->pic_uris->len)
+    else if (!previous && priv->nth_media == priv->tweet_item->n_pictures)
     {
         return;
     }
 
-    gtk_container_remove (GTK_CONTAINER (priv->scrolled), priv->cur_image);
+    /* The previous image may not have been loaded yet. */
+    if (priv->cur_image != NULL)
+    {
+        gtk_container_remove (GTK_CONTAINER (priv->scrolled), priv->cur_image);
+        priv->cur_image = NULL;
+    }
 
     priv->nth_media = previous ? priv->nth_media - 1 : priv->nth_media + 1;
 
     /* Reveal the previous and next button or not */
     gtk_widget_set_visible (priv->previous_revealer, priv->nth_media != 1);
     gtk_widget_set_visible (priv->next_revealer,
-                            priv->nth_media != priv->pic_uris->len);
+                            priv->nth_media != priv->tweet_item->n_pictures);
 
-    thumbnail_uri = g_array_index (priv->pic_uris, gchar *, priv->nth_media - 1);
-    wb_media_dialog_download_original_image (media_dialog, thumbnail_uri);
+    wb_media_dialog_download_original_image (media_dialog);
 }
 
 static void
@@ -183,43 +202,43 @@ next_button_clicked_cb (GtkButton *button,
 }
 
 static void
-on_message_complete (SoupSession *session,
-                     SoupMessage *msg,
-                     gpointer user_data)
+image_loaded_cb (GObject *source_object,
+                 GAsyncResult *result,
+                 gpointer user_data)
 {
-    g_autoptr(GInputStream) stream = NULL;
     gint width;
     gint height;
-    GdkPixbuf *pixbuf;
+    gdouble x_scale;
+    gdouble y_scale;
+    cairo_surface_t *surface;
     GError *error = NULL;
-    WbMediaDialog *self = WB_MEDIA_DIALOG (user_data);
-    WbMediaDialogPrivate *priv = wb_media_dialog_get_instance_private (self);
+    WbMediaDialog *self;
+    WbMediaDialogPrivate *priv;
 
-    if (!SOUP_STATUS_IS_SUCCESSFUL (msg->status_code))
+    surface = wb_image_loader_load_finish (WB_IMAGE_LOADER (source_object),
+                                           result, &error);
+    if (surface == NULL)
     {
-        if (msg->status_code != SOUP_STATUS_CANCELLED)
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
         {
-            g_warning ("Failed to get image: %d %s.\n",
-                       msg->status_code, msg->reason_phrase);
+            g_warning ("Failed to get image: %s", error->message);
         }
+
+        g_error_free (error);
+
         return;
     }
 
-    stream = g_memory_input_stream_new_from_data (msg->response_body->data,
-                                                  msg->response_body->length,
-                                                  NULL);
-    pixbuf = gdk_pixbuf_new_from_stream (stream, NULL, &error);
-    if (error != NULL)
-    {
-        g_warning ("Unable to create pixbuf: %s",
-                   error->message);
-        g_clear_error (&error);
-    }
+    self = WB_MEDIA_DIALOG (user_data);
+    priv = wb_media_dialog_get_instance_private (self);
 
-    /* Scale the image a bit so that it's not too large */
-    width = gdk_pixbuf_get_width (pixbuf);
-    height = gdk_pixbuf_get_height (pixbuf);
-    priv->cur_image = wb_util_scale_image (pixbuf, &width, &height);
+    g_clear_object (&priv->cancellable);
+
+    /* The window is sized in application pixels. */
+    cairo_surface_get_device_scale (surface, &x_scale, &y_scale);
+    width = cairo_image_surface_get_width (surface) / x_scale;
+    height = cairo_image_surface_get_height (surface) / y_scale;
+    priv->cur_image = gtk_image_new_from_surface (surface);
 
     gtk_widget_show (priv->cur_image);
     gtk_container_add (GTK_CONTAINER (priv->scrolled), priv->cur_image);
@@ -227,26 +246,40 @@ on_message_complete (SoupSession *session,
                        width,
                        height < MAX_HEIGHT ? height : MAX_HEIGHT);
 
-    g_object_unref (pixbuf);
+    cairo_surface_destroy (surface);
 }
 
 static void
 wb_media_dialog_setup (WbMediaDialog *self)
 {
-    const gchar *thumbnail_uri;
-    WbMediaDialogPrivate *priv;
+    wb_media_dialog_download_original_image (self);
+}
 
-    priv = wb_media_dialog_get_instance_private (self);
+static void
+wb_media_dialog_dispose (GObject *object)
+{
+    WbMediaDialog *self = WB_MEDIA_DIALOG (object);
+    WbMediaDialogPrivate *priv = wb_media_dialog_get_instance_private (self);
+
+    if (priv->cancellable != NULL)
+    {
+        g_cancellable_cancel (priv->cancellable);
+        g_clear_object (&priv->cancellable);
+    }
 
-    thumbnail_uri = g_array_index (priv->pic_uris, gchar *, priv->nth_media - 1);
-    wb_media_dialog_download_original_image (self, thumbnail_uri);
+    g_clear_object (&priv->tweet_item);
+
+    G_OBJECT_CLASS (wb_media_dialog_parent_class)->dispose (object);
 }
 
 static void
 wb_media_dialog_class_init (WbMediaDialogClass *klass)
 {
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
     GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
+    object_class->dispose = wb_media_dialog_dispose;
+
     gtk_widget_class_set_template_from_resource (widget_class,
                                                  "/com/jonathankang/Weibird/wb-media-dialog.ui");
     gtk_widget_class_bind_template_child_private (widget_class, WbMediaDialog,
@@ -272,6 +305,9 @@ wb_media_dialog_init (WbMediaDialog *self)
 
     gtk_widget_init_template (GTK_WIDGET (self));
 
+    priv->cancellable = NULL;
+    priv->cur_image = NULL;
+
     gtk_revealer_set_transition_type (GTK_REVEALER (priv->previous_revealer),
                                       GTK_REVEALER_TRANSITION_TYPE_CROSSFADE);
     gtk_revealer_set_transition_type (GTK_REVEALER (priv->next_revealer),
@@ -290,7 +326,7 @@ wb_media_dialog_init (WbMediaDialog *self)
  * Returns: (transfer full): a newly created #WbMediaDialog
  */
 WbMediaDialog *
-wb_media_dialog_new (const GArray *pic_uris,
+wb_media_dialog_new (WbTweetItem *tweet_item,
                      gint nth_media)
 {
     WbMediaDialog *self;
@@ -299,7 +335,8 @@ wb_media_dialog_new (const GArray *pic_uris,
     self = g_object_new (WB_TYPE_MEDIA_DIALOG, NULL);
     priv = wb_media_dialog_get_instance_private (self);
 
-    priv->pic_uris = pic_uris;
+    /* The row showing the post may go away while the dialog is open. */
+    priv->tweet_item = g_object_ref (tweet_item);
     priv->nth_media = nth_media;
 
     /* Whether to reveal the previous and next button or not */
@@ -307,7 +344,7 @@ wb_media_dialog_new (const GArray *pic_uris,
     {
         gtk_widget_hide (priv->previous_revealer);
     }
-    if (priv->nth_media == priv->pic_uris->len)
+    if (priv->nth_media == priv->tweet_item->n_pictures)
     {
         gtk_widget_hide (priv->next_revealer);
     }
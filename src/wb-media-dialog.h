@@ -23,13 +23,15 @@
 
 #include <gtk/gtk.h>
 
+#include "wb-tweet-item.h"
+
 G_BEGIN_DECLS
 
 #define WB_TYPE_MEDIA_DIALOG (wb_media_dialog_get_type ())
 G_DECLARE_FINAL_TYPE (WbMediaDialog, wb_media_dialog, WB, MEDIA_DIALOG, GtkWindow)
 
 GtkWidget *wb_media_dialog_get_frame (WbMediaDialog *dialog);
-WbMediaDialog *wb_media_dialog_new (const GArray *pic_uris, gint nth_media);
+WbMediaDialog *wb_media_dialog_new (WbTweetItem *tweet_item, gint nth_media);
 
 G_END_DECLS
 
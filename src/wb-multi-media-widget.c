@@ -31,7 +31,7 @@ struct _WbMultiMediaWidget
 
 typedef struct
 {
-    const GArray *pic_uris;
+    WbTweetItem *tweet_item;
 } WbMultiMediaWidgetPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (WbMultiMediaWidget, wb_multi_media_widget, GTK_TYPE_GRID)
@@ -52,7 +52,7 @@ on_image_clicked (GtkButton *button,
     priv = wb_multi_media_widget_get_instance_private (mm_widget);
 
     nth_media = wb_image_button_get_nth_media (image_button);
-    dialog = wb_media_dialog_new (priv->pic_uris, nth_media);
+    dialog = wb_media_dialog_new (priv->tweet_item, nth_media);
     /* FIXME: Initialize the dialog in a proper size. */
     gtk_window_set_default_size (GTK_WINDOW (dialog), 100, 100);
 
@@ -64,7 +64,7 @@ on_image_clicked (GtkButton *button,
 
 void
 wb_multi_media_widget_populate_images (WbMultiMediaWidget *self,
-                                       const GArray *pic_uris)
+                                       WbTweetItem *tweet_item)
 {
     gint i;
     gint n_childs;
@@ -74,9 +74,9 @@ wb_multi_media_widget_populate_images (WbMultiMediaWidget *self,
     WbMultiMediaWidgetPrivate *priv;
 
     priv = wb_multi_media_widget_get_instance_private (self);
-    priv->pic_uris = pic_uris;
+    g_set_object (&priv->tweet_item, tweet_item);
 
-    n_childs = pic_uris->len;
+    n_childs = tweet_item->n_pictures;
 
     /* Adjust the image size based on how many images there are
      * in a post. */
@@ -95,9 +95,13 @@ wb_multi_media_widget_populate_images (WbMultiMediaWidget *self,
 
     for (i = 0; i < n_childs; i++)
     {
-        button = wb_image_button_new (WB_MEDIA_TYPE_IMAGE,
-                                      g_array_index (pic_uris, gchar *, i),
+        gchar *uri;
+
+        uri = wb_tweet_item_get_picture_uri (tweet_item, i,
+                                             WB_PICTURE_SIZE_THUMBNAIL);
+        button = wb_image_button_new (WB_MEDIA_TYPE_IMAGE, uri,
                                       i + 1, width, height);
+        g_free (uri);
 
         g_signal_connect (button, "clicked",
                           G_CALLBACK (on_image_clicked), self);
@@ -143,9 +147,23 @@ wb_multi_media_widget_populate_images (WbMultiMediaWidget *self,
     }
 }
 
+static void
+wb_multi_media_widget_dispose (GObject *object)
+{
+    WbMultiMediaWidget *self = WB_MULTI_MEDIA_WIDGET (object);
+    WbMultiMediaWidgetPrivate *priv = wb_multi_media_widget_get_instance_private (self);
+
+    g_clear_object (&priv->tweet_item);
+
+    G_OBJECT_CLASS (wb_multi_media_widget_parent_class)->dispose (object);
+}
+
 static void
 wb_multi_media_widget_class_init(WbMultiMediaWidgetClass *klass)
 {
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = wb_multi_media_widget_dispose;
 }
 
 static void
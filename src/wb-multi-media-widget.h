@@ -23,13 +23,15 @@
 
 #include <gtk/gtk.h>
 
+#include "wb-tweet-item.h"
+
 G_BEGIN_DECLS
 
 #define WB_TYPE_MULTI_MEDIA_WIDGET (wb_multi_media_widget_get_type ())
 G_DECLARE_FINAL_TYPE (WbMultiMediaWidget, wb_multi_media_widget, WB, MULTI_MEDIA_WIDGET, GtkGrid)
 
 void wb_multi_media_widget_populate_images (WbMultiMediaWidget *self,
-                                            const GArray *pic_uris);
+                                            WbTweetItem *tweet_item);
 WbMultiMediaWidget *wb_multi_media_widget_new (void);
 
 G_END_DECLS
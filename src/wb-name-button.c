@@ -23,6 +23,9 @@
 struct _WbNameButton
 {
 		GtkButton parent_instance;
+
+    GtkWidget *label;
+    WbUser *user;
 };
 
 G_DEFINE_TYPE (WbNameButton, wb_name_button, GTK_TYPE_BUTTON)
@@ -31,18 +34,75 @@ void
 wb_name_button_set_text (WbNameButton *self,
                          const gchar *text)
 {
-    GtkWidget *label;
+    g_return_if_fail (WB_IS_NAME_BUTTON (self));
 
+    if (self->label == NULL)
+    {
+        self->label = gtk_label_new (text);
+        gtk_widget_show (self->label);
+        gtk_container_add (GTK_CONTAINER (self), self->label);
+    }
+    else
+    {
+        gtk_label_set_text (GTK_LABEL (self->label), text);
+    }
+}
+
+static void
+user_name_changed_cb (GObject *object,
+                      GParamSpec *pspec,
+                      gpointer user_data)
+{
+    WbNameButton *self = WB_NAME_BUTTON (user_data);
+
+    wb_name_button_set_text (self, wb_user_get_display_name (self->user));
+}
+
+/**
+ * wb_name_button_set_user:
+ * @button: a #WbNameButton
+ * @user: a #WbUser
+ *
+ * Show the name of @user, and keep showing it when the user is renamed.
+ */
+void
+wb_name_button_set_user (WbNameButton *self,
+                         WbUser *user)
+{
     g_return_if_fail (WB_IS_NAME_BUTTON (self));
+    g_return_if_fail (WB_IS_USER (user));
+
+    if (self->user != NULL)
+    {
+        g_signal_handlers_disconnect_by_func (self->user,
+                                              user_name_changed_cb, self);
+    }
+
+    g_set_object (&self->user, user);
+    g_signal_connect_object (user, "notify::name",
+                             G_CALLBACK (user_name_changed_cb), self, 0);
+    g_signal_connect_object (user, "notify::nickname",
+                             G_CALLBACK (user_name_changed_cb), self, 0);
+
+    wb_name_button_set_text (self, wb_user_get_display_name (user));
+}
+
+static void
+wb_name_button_dispose (GObject *object)
+{
+    WbNameButton *self = WB_NAME_BUTTON (object);
+
+    g_clear_object (&self->user);
 
-    label = gtk_label_new (text);
-    gtk_widget_show (label);
-    gtk_container_add (GTK_CONTAINER (self), label);
+    G_OBJECT_CLASS (wb_name_button_parent_class)->dispose (object);
 }
 
 static void
 wb_name_button_class_init (WbNameButtonClass *klass)
 {
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = wb_name_button_dispose;
 }
 
 static void
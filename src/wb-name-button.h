@@ -20,6 +20,8 @@
 
 #include <gtk/gtk.h>
 
+#include "wb-user.h"
+
 G_BEGIN_DECLS
 
 #define WB_TYPE_NAME_BUTTON (wb_name_button_get_type ())
@@ -27,6 +29,7 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (WbNameButton, wb_name_button, WB, NAME_BUTTON, GtkButton)
 
 void wb_name_button_set_text (WbNameButton *button, const gchar *text);
+void wb_name_button_set_user (WbNameButton *button, WbUser *user);
 WbNameButton *wb_name_button_new (void);
 
 G_END_DECLS
@@ -0,0 +1,807 @@
+/*
+ *  Weibird - View and compose weibo
+ *  Copyright (C) 2019 Jonathan Kang <jonathankang@gnome.org>.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cairo.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "wb-application.h"
+#include "wb-entity-store.h"
+#include "wb-image-loader.h"
+#include "wb-snapshot.h"
+#include "wb-tweet-item.h"
+#include "wb-user.h"
+
+/* The snapshot is used in place, straight from the mapped file. It is
+ * written and read by the same program on the same machine, so the
+ * records are in host byte order; bump the version whenever one of
+ * them changes. */
+#define SNAPSHOT_MAGIC "WBSNAP\r\n"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_NONE G_MAXUINT32
+/* Pixel data starts on a cache line. */
+#define SNAPSHOT_ALIGNMENT 64
+/* Only images the size of an avatar or a thumbnail are saved, and only
+ * up to this many bytes of them. */
+#define SNAPSHOT_MAX_IMAGE_PIXELS (600 * 600)
+#define SNAPSHOT_MAX_IMAGES_SIZE (32 * 1024 * 1024)
+
+typedef struct
+{
+    gchar magic[8];
+    guint32 version;
+    /* Catch files written with differently laid out records. */
+    guint32 post_size;
+    guint32 user_size;
+    guint32 image_size;
+    /* The timeline, in the first n_posts records, newest first. The
+     * reposted posts come after them. */
+    guint32 n_posts;
+    guint32 n_records;
+    guint32 n_users;
+    guint32 n_images;
+    guint64 records_offset;
+    guint64 users_offset;
+    guint64 images_offset;
+    guint64 strings_offset;
+    guint64 strings_size;
+    guint64 file_size;
+} WbSnapshotHeader;
+
+/* Strings are offsets into the string area, or SNAPSHOT_NONE. Each of
+ * them ends with a nul byte. */
+typedef struct
+{
+    gint64 id;
+    gint64 mid;
+    gint64 created_at;
+    guint32 text;
+    guint32 source;
+    guint32 pic_host;
+    guint32 pic_ids;
+    guint32 pic_ids_length;
+    guint32 n_pictures;
+    gint32 reposts_count;
+    gint32 comments_count;
+    gint32 attitudes_count;
+    guint32 favourited;
+    /* Index of the author in the users. */
+    guint32 user;
+    /* Index of the reposted post in the records, always after this one,
+     * or SNAPSHOT_NONE. */
+    guint32 retweeted;
+} WbSnapshotPost;
+
+typedef struct
+{
+    gint64 id;
+    guint32 idstr;
+    guint32 name;
+    guint32 nickname;
+    guint32 location;
+    guint32 profile_image_url;
+    guint32 avatar_large;
+    guint32 avatar_hd;
+    guint32 padding;
+} WbSnapshotUser;
+
+/* An image as the image loader caches it, ready to be drawn. */
+typedef struct
+{
+    /* Cache key of the image. */
+    guint32 key;
+    gint32 format;
+    gint32 width;
+    gint32 height;
+    gint32 stride;
+    guint32 padding;
+    gdouble x_scale;
+    gdouble y_scale;
+    /* Offset of the pixels in the file. */
+    guint64 data;
+} WbSnapshotImage;
+
+typedef struct
+{
+    GArray *posts;
+    GArray *users;
+    GArray *images;
+    GByteArray *strings;
+    /* User id → index + 1 in users. */
+    GHashTable *user_indices;
+    /* Uris of the avatars and pictures of the posts. */
+    GHashTable *uris;
+    /* The surfaces of images, with data relative to the pixel area. */
+    GPtrArray *surfaces;
+    gsize images_size;
+} WbSnapshotWriter;
+
+static const cairo_user_data_key_t mapped_file_key;
+
+static gchar *
+wb_snapshot_get_path (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "weibird", "snapshot",
+                             NULL);
+}
+
+static guint32
+wb_snapshot_add_data (WbSnapshotWriter *writer,
+                      const gchar *data,
+                      gsize length)
+{
+    guint32 offset;
+
+    if (data == NULL)
+    {
+        return SNAPSHOT_NONE;
+    }
+
+    offset = writer->strings->len;
+    g_byte_array_append (writer->strings, (const guint8 *) data, length);
+    g_byte_array_append (writer->strings, (const guint8 *) "", 1);
+
+    return offset;
+}
+
+static guint32
+wb_snapshot_add_string (WbSnapshotWriter *writer,
+                        const gchar *str)
+{
+    return wb_snapshot_add_data (writer, str, str != NULL ? strlen (str) : 0);
+}
+
+static guint32
+wb_snapshot_add_user (WbSnapshotWriter *writer,
+                      WbUser *user)
+{
+    guint32 index;
+    WbSnapshotUser record = { 0 };
+
+    index = GPOINTER_TO_UINT (g_hash_table_lookup (writer->user_indices,
+                                                   &user->id));
+    if (index != 0)
+    {
+        return index - 1;
+    }
+
+    record.id = user->id;
+    record.idstr = wb_snapshot_add_string (writer, user->idstr);
+    record.name = wb_snapshot_add_string (writer, user->name);
+    record.nickname = wb_snapshot_add_string (writer, user->nickname);
+    record.location = wb_snapshot_add_string (writer, user->location);
+    record.profile_image_url = wb_snapshot_add_string (writer,
+                                                       user->profile_image_url);
+    record.avatar_large = wb_snapshot_add_string (writer, user->avatar_large);
+    record.avatar_hd = wb_snapshot_add_string (writer, user->avatar_hd);
+
+    /* Whichever the avatar widgets picked. */
+    if (user->profile_image_url != NULL)
+    {
+        g_hash_table_add (writer->uris, g_strdup (user->profile_image_url));
+    }
+    if (user->avatar_large != NULL)
+    {
+        g_hash_table_add (writer->uris, g_strdup (user->avatar_large));
+    }
+    if (user->avatar_hd != NULL)
+    {
+        g_hash_table_add (writer->uris, g_strdup (user->avatar_hd));
+    }
+
+    index = writer->users->len;
+    g_array_append_val (writer->users, record);
+    g_hash_table_insert (writer->user_indices, &user->id,
+                         GUINT_TO_POINTER (index + 1));
+
+    return index;
+}
+
+static void
+wb_snapshot_set_post (WbSnapshotWriter *writer,
+                      guint32 index,
+                      WbTweetItem *tweet_item)
+{
+    guint i;
+    const gchar *p;
+    WbSnapshotPost record = { 0 };
+
+    record.id = tweet_item->id;
+    record.mid = tweet_item->mid;
+    record.created_at = tweet_item->created_at;
+    record.text = wb_snapshot_add_string (writer, tweet_item->text);
+    record.source = wb_snapshot_add_string (writer, tweet_item->source);
+    record.pic_host = wb_snapshot_add_string (writer, tweet_item->pic_host);
+    record.n_pictures = tweet_item->n_pictures;
+    record.reposts_count = tweet_item->reposts_count;
+    record.comments_count = tweet_item->comments_count;
+    record.attitudes_count = tweet_item->attitudes_count;
+    record.favourited = tweet_item->favourited;
+    record.user = tweet_item->user != NULL
+                  ? wb_snapshot_add_user (writer, tweet_item->user)
+                  : SNAPSHOT_NONE;
+
+    /* The picture file names, with their nul bytes. */
+    p = tweet_item->pic_ids;
+    for (i = 0; i < tweet_item->n_pictures; i++)
+    {
+        p += strlen (p) + 1;
+    }
+    if (tweet_item->pic_ids != NULL)
+    {
+        record.pic_ids_length = p - tweet_item->pic_ids;
+        record.pic_ids = wb_snapshot_add_data (writer, tweet_item->pic_ids,
+                                               record.pic_ids_length);
+    }
+    else
+    {
+        record.pic_ids = SNAPSHOT_NONE;
+    }
+
+    /* Whichever size the image buttons picked. */
+    for (i = 0; i < tweet_item->n_pictures; i++)
+    {
+        WbPictureSize size;
+
+        for (size = WB_PICTURE_SIZE_THUMBNAIL; size <= WB_PICTURE_SIZE_LARGE; size++)
+        {
+            g_hash_table_add (writer->uris,
+                              wb_tweet_item_get_picture_uri (tweet_item, i, size));
+        }
+    }
+
+    if (tweet_item->retweeted_item != NULL)
+    {
+        WbSnapshotPost retweeted = { 0 };
+
+        record.retweeted = writer->posts->len;
+        g_array_append_val (writer->posts, retweeted);
+        wb_snapshot_set_post (writer, record.retweeted,
+                              tweet_item->retweeted_item);
+    }
+    else
+    {
+        record.retweeted = SNAPSHOT_NONE;
+    }
+
+    g_array_index (writer->posts, WbSnapshotPost, index) = record;
+}
+
+static void
+wb_snapshot_add_image (const gchar *key,
+                       cairo_surface_t *surface,
+                       gpointer user_data)
+{
+    gint height;
+    gint stride;
+    gsize size;
+    cairo_format_t format;
+    WbSnapshotImage record = { 0 };
+    WbSnapshotWriter *writer = user_data;
+
+    format = cairo_image_surface_get_format (surface);
+    height = cairo_image_surface_get_height (surface);
+    stride = cairo_image_surface_get_stride (surface);
+    size = (gsize) stride * height;
+
+    if ((format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_RGB24) ||
+        (gsize) cairo_image_surface_get_width (surface) * height > SNAPSHOT_MAX_IMAGE_PIXELS ||
+        writer->images_size + size > SNAPSHOT_MAX_IMAGES_SIZE)
+    {
+        return;
+    }
+
+    record.key = wb_snapshot_add_string (writer, key);
+    record.format = format;
+    record.width = cairo_image_surface_get_width (surface);
+    record.height = height;
+    record.stride = stride;
+    cairo_surface_get_device_scale (surface, &record.x_scale, &record.y_scale);
+    /* Relative to the pixel area until its offset is known. */
+    record.data = writer->images_size;
+
+    g_array_append_val (writer->images, record);
+    g_ptr_array_add (writer->surfaces, cairo_surface_reference (surface));
+
+    writer->images_size += (size + SNAPSHOT_ALIGNMENT - 1)
+                           & ~(gsize) (SNAPSHOT_ALIGNMENT - 1);
+}
+
+/**
+ * wb_snapshot_save:
+ * @items: (element-type WbTweetItem): the posts at the top of the
+ * timeline, newest first
+ *
+ * Write @items, their authors, and their avatars and thumbnails which
+ * are in the memory cache of the image loader to the snapshot, to be
+ * shown by wb_snapshot_load() next time. The images are saved the way
+ * they are drawn, so that nothing has to be decoded at startup.
+ */
+void
+wb_snapshot_save (GPtrArray *items)
+{
+    guint i;
+    guint64 pixels_offset;
+    g_autofree gchar *path = NULL;
+    GByteArray *contents;
+    GError *error = NULL;
+    WbImageLoader *image_loader;
+    WbSnapshotHeader header = { { 0 } };
+    WbSnapshotWriter writer;
+
+    g_return_if_fail (items != NULL);
+
+    writer.posts = g_array_new (FALSE, TRUE, sizeof (WbSnapshotPost));
+    writer.users = g_array_new (FALSE, TRUE, sizeof (WbSnapshotUser));
+    writer.images = g_array_new (FALSE, TRUE, sizeof (WbSnapshotImage));
+    writer.strings = g_byte_array_new ();
+    writer.user_indices = g_hash_table_new (g_int64_hash, g_int64_equal);
+    writer.uris = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    writer.surfaces = g_ptr_array_new_with_free_func ((GDestroyNotify) cairo_surface_destroy);
+    writer.images_size = 0;
+
+    /* The timeline first, the reposted posts are appended after it. */
+    g_array_set_size (writer.posts, items->len);
+    for (i = 0; i < items->len; i++)
+    {
+        wb_snapshot_set_post (&writer, i, g_ptr_array_index (items, i));
+    }
+
+    image_loader = wb_application_get_image_loader (WB_APPLICATION (g_application_get_default ()));
+    if (image_loader != NULL)
+    {
+        wb_image_loader_foreach_cached (image_loader, writer.uris,
+                                        wb_snapshot_add_image, &writer);
+    }
+
+    memcpy (header.magic, SNAPSHOT_MAGIC, sizeof (header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.post_size = sizeof (WbSnapshotPost);
+    header.user_size = sizeof (WbSnapshotUser);
+    header.image_size = sizeof (WbSnapshotImage);
+    header.n_posts = items->len;
+    header.n_records = writer.posts->len;
+    header.n_users = writer.users->len;
+    header.n_images = writer.images->len;
+    header.records_offset = sizeof (WbSnapshotHeader);
+    header.users_offset = header.records_offset
+                          + (guint64) header.n_records * sizeof (WbSnapshotPost);
+    header.images_offset = header.users_offset
+                           + (guint64) header.n_users * sizeof (WbSnapshotUser);
+    header.strings_offset = header.images_offset
+                            + (guint64) header.n_images * sizeof (WbSnapshotImage);
+    header.strings_size = writer.strings->len;
+    pixels_offset = (header.strings_offset + header.strings_size
+                     + SNAPSHOT_ALIGNMENT - 1) & ~(guint64) (SNAPSHOT_ALIGNMENT - 1);
+    header.file_size = pixels_offset + writer.images_size;
+
+    for (i = 0; i < writer.images->len; i++)
+    {
+        g_array_index (writer.images, WbSnapshotImage, i).data += pixels_offset;
+    }
+
+    contents = g_byte_array_sized_new (header.file_size);
+    g_byte_array_append (contents, (const guint8 *) &header, sizeof (header));
+    g_byte_array_append (contents, (const guint8 *) writer.posts->data,
+                         writer.posts->len * sizeof (WbSnapshotPost));
+    g_byte_array_append (contents, (const guint8 *) writer.users->data,
+                         writer.users->len * sizeof (WbSnapshotUser));
+    g_byte_array_append (contents, (const guint8 *) writer.images->data,
+                         writer.images->len * sizeof (WbSnapshotImage));
+    g_byte_array_append (contents, writer.strings->data, writer.strings->len);
+    g_byte_array_set_size (contents, pixels_offset);
+
+    for (i = 0; i < writer.surfaces->len; i++)
+    {
+        cairo_surface_t *surface = g_ptr_array_index (writer.surfaces, i);
+        WbSnapshotImage *record = &g_array_index (writer.images,
+                                                  WbSnapshotImage, i);
+
+        cairo_surface_flush (surface);
+        g_byte_array_set_size (contents, record->data);
+        g_byte_array_append (contents, cairo_image_surface_get_data (surface),
+                             (gsize) record->stride * record->height);
+    }
+    g_byte_array_set_size (contents, header.file_size);
+
+    /* Replaced atomically, a mapping of the previous one stays valid. */
+    path = wb_snapshot_get_path ();
+    if (!g_file_set_contents (path, (const gchar *) contents->data,
+                              contents->len, &error))
+    {
+        g_warning ("Failed to save the timeline snapshot: %s", error->message);
+        g_error_free (error);
+    }
+
+    g_byte_array_unref (contents);
+    g_array_free (writer.posts, TRUE);
+    g_array_free (writer.users, TRUE);
+    g_array_free (writer.images, TRUE);
+    g_byte_array_unref (writer.strings);
+    g_hash_table_destroy (writer.user_indices);
+    g_hash_table_destroy (writer.uris);
+    g_ptr_array_unref (writer.surfaces);
+}
+
+/**
+ * wb_snapshot_discard:
+ *
+ * Remove the snapshot, it doesn't show the top of the timeline
+ * anymore.
+ */
+void
+wb_snapshot_discard (void)
+{
+    g_autofree gchar *path = NULL;
+
+    path = wb_snapshot_get_path ();
+    g_unlink (path);
+}
+
+static gboolean
+wb_snapshot_check_range (guint64 offset,
+                         guint64 n,
+                         guint64 size,
+                         guint64 file_size)
+{
+    return offset <= file_size && n <= (file_size - offset) / MAX (size, 1);
+}
+
+static gboolean
+wb_snapshot_check_string (const WbSnapshotHeader *header,
+                          guint32 offset)
+{
+    return offset == SNAPSHOT_NONE || offset < header->strings_size;
+}
+
+/* The picture file names of @post must be exactly n_pictures strings,
+ * each ending with a nul byte, for wb_tweet_item_get_picture_uri(). */
+static gboolean
+wb_snapshot_check_pic_ids (const WbSnapshotHeader *header,
+                           const gchar *strings,
+                           const WbSnapshotPost *post)
+{
+    guint32 i;
+    guint32 n_names;
+    const gchar *pic_ids;
+
+    if (post->pic_ids == SNAPSHOT_NONE)
+    {
+        return post->n_pictures == 0;
+    }
+
+    if (post->pic_ids >= header->strings_size ||
+        post->pic_ids_length > header->strings_size - post->pic_ids)
+    {
+        return FALSE;
+    }
+
+    if (post->pic_ids_length == 0)
+    {
+        return post->n_pictures == 0;
+    }
+
+    pic_ids = strings + post->pic_ids;
+    if (pic_ids[post->pic_ids_length - 1] != '\0')
+    {
+        return FALSE;
+    }
+
+    n_names = 0;
+    for (i = 0; i < post->pic_ids_length; i++)
+    {
+        if (pic_ids[i] == '\0')
+        {
+            n_names++;
+        }
+    }
+
+    return n_names == post->n_pictures;
+}
+
+static const gchar *
+wb_snapshot_get_string (const gchar *strings,
+                        guint32 offset)
+{
+    return offset != SNAPSHOT_NONE ? strings + offset : NULL;
+}
+
+static gboolean
+wb_snapshot_check (const gchar *contents,
+                   gsize length)
+{
+    guint i;
+    const WbSnapshotHeader *header = (const WbSnapshotHeader *) contents;
+    const WbSnapshotPost *posts;
+    const WbSnapshotUser *users;
+    const WbSnapshotImage *images;
+
+    if (length < sizeof (WbSnapshotHeader) ||
+        memcmp (header->magic, SNAPSHOT_MAGIC, sizeof (header->magic)) != 0 ||
+        header->version != SNAPSHOT_VERSION ||
+        header->post_size != sizeof (WbSnapshotPost) ||
+        header->user_size != sizeof (WbSnapshotUser) ||
+        header->image_size != sizeof (WbSnapshotImage) ||
+        header->file_size != length ||
+        header->n_posts > header->n_records ||
+        header->records_offset % 8 != 0 ||
+        header->users_offset % 8 != 0 ||
+        header->images_offset % 8 != 0 ||
+        !wb_snapshot_check_range (header->records_offset, header->n_records,
+                                  sizeof (WbSnapshotPost), length) ||
+        !wb_snapshot_check_range (header->users_offset, header->n_users,
+                                  sizeof (WbSnapshotUser), length) ||
+        !wb_snapshot_check_range (header->images_offset, header->n_images,
+                                  sizeof (WbSnapshotImage), length) ||
+        !wb_snapshot_check_range (header->strings_offset, header->strings_size,
+                                  1, length))
+    {
+        return FALSE;
+    }
+
+    /* Every string ends with a nul byte, so does the area. */
+    if (header->strings_size != 0 &&
+        contents[header->strings_offset + header->strings_size - 1] != '\0')
+    {
+        return FALSE;
+    }
+
+    posts = (const WbSnapshotPost *) (contents + header->records_offset);
+    for (i = 0; i < header->n_records; i++)
+    {
+        const WbSnapshotPost *post = &posts[i];
+
+        if (!wb_snapshot_check_string (header, post->text) ||
+            !wb_snapshot_check_string (header, post->source) ||
+            !wb_snapshot_check_string (header, post->pic_host) ||
+            !wb_snapshot_check_pic_ids (header,
+                                        contents + header->strings_offset,
+                                        post) ||
+            (post->user != SNAPSHOT_NONE && post->user >= header->n_users) ||
+            (post->retweeted != SNAPSHOT_NONE &&
+             (post->retweeted <= i || post->retweeted >= header->n_records)))
+        {
+            return FALSE;
+        }
+    }
+
+    users = (const WbSnapshotUser *) (contents + header->users_offset);
+    for (i = 0; i < header->n_users; i++)
+    {
+        const WbSnapshotUser *user = &users[i];
+
+        if (!wb_snapshot_check_string (header, user->idstr) ||
+            !wb_snapshot_check_string (header, user->name) ||
+            !wb_snapshot_check_string (header, user->nickname) ||
+            !wb_snapshot_check_string (header, user->location) ||
+            !wb_snapshot_check_string (header, user->profile_image_url) ||
+            !wb_snapshot_check_string (header, user->avatar_large) ||
+            !wb_snapshot_check_string (header, user->avatar_hd))
+        {
+            return FALSE;
+        }
+    }
+
+    images = (const WbSnapshotImage *) (contents + header->images_offset);
+    for (i = 0; i < header->n_images; i++)
+    {
+        const WbSnapshotImage *image = &images[i];
+
+        if (image->key == SNAPSHOT_NONE ||
+            !wb_snapshot_check_string (header, image->key) ||
+            (image->format != CAIRO_FORMAT_ARGB32 &&
+             image->format != CAIRO_FORMAT_RGB24) ||
+            image->width <= 0 || image->height <= 0 ||
+            image->stride != cairo_format_stride_for_width (image->format,
+                                                            image->width) ||
+            image->data % SNAPSHOT_ALIGNMENT != 0 ||
+            !wb_snapshot_check_range (image->data, image->height,
+                                      image->stride, length))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static WbUser *
+wb_snapshot_new_user (const WbSnapshotUser *record,
+                      const gchar *strings)
+{
+    WbUser *user;
+
+    user = g_object_new (WB_TYPE_USER, NULL);
+    user->id = record->id;
+    user->idstr = g_strdup (wb_snapshot_get_string (strings, record->idstr));
+    user->name = g_strdup (wb_snapshot_get_string (strings, record->name));
+    user->nickname = g_strdup (wb_snapshot_get_string (strings, record->nickname));
+    user->location = g_strdup (wb_snapshot_get_string (strings, record->location));
+    user->profile_image_url = g_strdup (wb_snapshot_get_string (strings,
+                                                                record->profile_image_url));
+    user->avatar_large = g_strdup (wb_snapshot_get_string (strings,
+                                                           record->avatar_large));
+    user->avatar_hd = g_strdup (wb_snapshot_get_string (strings,
+                                                        record->avatar_hd));
+
+    return user;
+}
+
+static WbTweetItem *
+wb_snapshot_new_post (const WbSnapshotPost *record,
+                      const gchar *strings,
+                      GPtrArray *users,
+                      GPtrArray *records)
+{
+    WbTweetItem *tweet_item;
+
+    tweet_item = g_object_new (WB_TYPE_TWEET_ITEM, NULL);
+    tweet_item->id = record->id;
+    tweet_item->mid = record->mid;
+    tweet_item->created_at = record->created_at;
+    tweet_item->text = g_strdup (wb_snapshot_get_string (strings, record->text));
+    tweet_item->source = g_intern_string (wb_snapshot_get_string (strings,
+                                                                  record->source));
+    tweet_item->pic_host = g_intern_string (wb_snapshot_get_string (strings,
+                                                                    record->pic_host));
+    tweet_item->favourited = record->favourited;
+    tweet_item->reposts_count = record->reposts_count;
+    tweet_item->comments_count = record->comments_count;
+    tweet_item->attitudes_count = record->attitudes_count;
+
+    if (record->pic_ids != SNAPSHOT_NONE && record->n_pictures != 0)
+    {
+        tweet_item->pic_ids = g_malloc (record->pic_ids_length);
+        memcpy (tweet_item->pic_ids, strings + record->pic_ids,
+                record->pic_ids_length);
+        tweet_item->n_pictures = record->n_pictures;
+    }
+
+    if (record->user != SNAPSHOT_NONE)
+    {
+        tweet_item->user = g_object_ref (g_ptr_array_index (users, record->user));
+    }
+
+    /* Built already, it comes after this post. */
+    if (record->retweeted != SNAPSHOT_NONE)
+    {
+        tweet_item->retweeted_item = g_object_ref (g_ptr_array_index (records,
+                                                                      record->retweeted));
+    }
+
+    return tweet_item;
+}
+
+/**
+ * wb_snapshot_load:
+ *
+ * Map the snapshot written by wb_snapshot_save() and build the posts
+ * out of it. The avatars and thumbnails go to the memory cache of the
+ * image loader as they are, drawn straight from the mapped file.
+ *
+ * Returns: (transfer full) (element-type WbTweetItem) (nullable): the
+ * posts, newest first, or %NULL if there is no usable snapshot
+ */
+GPtrArray *
+wb_snapshot_load (void)
+{
+    guint i;
+    gchar *contents;
+    gsize length;
+    g_autofree gchar *path = NULL;
+    const gchar *strings;
+    const WbSnapshotHeader *header;
+    const WbSnapshotPost *posts;
+    const WbSnapshotUser *users;
+    const WbSnapshotImage *images;
+    GError *error = NULL;
+    GMappedFile *file;
+    GPtrArray *items;
+    GPtrArray *records;
+    GPtrArray *user_objects;
+    WbApplication *application;
+    WbEntityStore *entity_store;
+    WbImageLoader *image_loader;
+
+    path = wb_snapshot_get_path ();
+
+    /* Mapped privately, cairo gets writable pixels which are only
+     * copied if they are ever written to. */
+    file = g_mapped_file_new (path, TRUE, &error);
+    if (file == NULL)
+    {
+        if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        {
+            g_warning ("Failed to load the timeline snapshot: %s",
+                       error->message);
+        }
+
+        g_error_free (error);
+        return NULL;
+    }
+
+    contents = g_mapped_file_get_contents (file);
+    length = g_mapped_file_get_length (file);
+
+    if (contents == NULL || !wb_snapshot_check (contents, length))
+    {
+        g_mapped_file_unref (file);
+        wb_snapshot_discard ();
+
+        return NULL;
+    }
+
+    header = (const WbSnapshotHeader *) contents;
+    posts = (const WbSnapshotPost *) (contents + header->records_offset);
+    users = (const WbSnapshotUser *) (contents + header->users_offset);
+    images = (const WbSnapshotImage *) (contents + header->images_offset);
+    strings = contents + header->strings_offset;
+
+    application = WB_APPLICATION (g_application_get_default ());
+    image_loader = wb_application_get_image_loader (application);
+    entity_store = wb_application_get_entity_store (application);
+
+    for (i = 0; i < header->n_images; i++)
+    {
+        const WbSnapshotImage *image = &images[i];
+        cairo_surface_t *surface;
+
+        surface = cairo_image_surface_create_for_data ((guchar *) contents + image->data,
+                                                       image->format,
+                                                       image->width,
+                                                       image->height,
+                                                       image->stride);
+        cairo_surface_set_device_scale (surface, image->x_scale, image->y_scale);
+        /* The pixels stay mapped as long as the image is used. */
+        cairo_surface_set_user_data (surface, &mapped_file_key,
+                                     g_mapped_file_ref (file),
+                                     (cairo_destroy_func_t) g_mapped_file_unref);
+
+        wb_image_loader_add_cached (image_loader, strings + image->key, surface);
+        cairo_surface_destroy (surface);
+    }
+
+    user_objects = g_ptr_array_new_full (header->n_users, g_object_unref);
+    for (i = 0; i < header->n_users; i++)
+    {
+        g_ptr_array_add (user_objects, wb_snapshot_new_user (&users[i], strings));
+    }
+
+    /* Reposted posts come after the posts reposting them. */
+    records = g_ptr_array_new_full (header->n_records, g_object_unref);
+    g_ptr_array_set_size (records, header->n_records);
+    for (i = header->n_records; i > 0; i--)
+    {
+        records->pdata[i - 1] = wb_snapshot_new_post (&posts[i - 1], strings,
+                                                      user_objects, records);
+    }
+
+    items = g_ptr_array_new_full (header->n_posts, g_object_unref);
+    for (i = 0; i < header->n_posts; i++)
+    {
+        g_ptr_array_add (items,
+                         wb_entity_store_intern_status (entity_store,
+                                                        g_ptr_array_index (records, i)));
+    }
+
+    g_ptr_array_unref (records);
+    g_ptr_array_unref (user_objects);
+    g_mapped_file_unref (file);
+
+    return items;
+}
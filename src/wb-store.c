@@ -0,0 +1,1040 @@
+/*
+ *  Weibird - View and compose weibo
+ *  Copyright (C) 2019 Jonathan Kang <jonathankang@gnome.org>.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
+#include <sqlite3.h>
+
+#include "wb-application.h"
+#include "wb-comment.h"
+#include "wb-entity-store.h"
+#include "wb-store.h"
+#include "wb-tweet-item.h"
+#include "wb-user.h"
+
+/* Stores written with another version are dropped. Posts, users and
+ * comments are kept as the JSON data Weibo API returned, so this only
+ * changes along with the tables. */
+#define STORE_VERSION 1
+
+static const gchar SETTINGS_SCHEMA[] = "com.jonathankang.Weibird";
+static const gchar STORED_POSTS[] = "stored-posts";
+static const gchar UID[] = "uid";
+
+static const gchar CREATE_TABLES[] =
+    "CREATE TABLE IF NOT EXISTS statuses ("
+    "    id INTEGER PRIMARY KEY,"
+    "    user_id INTEGER,"
+    "    retweeted_id INTEGER,"
+    "    home INTEGER NOT NULL,"
+    "    json TEXT NOT NULL);"
+    "CREATE INDEX IF NOT EXISTS statuses_home ON statuses (home, id);"
+    "CREATE INDEX IF NOT EXISTS statuses_retweeted_id ON statuses (retweeted_id);"
+    "CREATE TABLE IF NOT EXISTS users ("
+    "    id INTEGER PRIMARY KEY,"
+    "    seen_id INTEGER NOT NULL,"
+    "    json TEXT NOT NULL);"
+    "CREATE TABLE IF NOT EXISTS comments ("
+    "    id INTEGER PRIMARY KEY,"
+    "    status_id INTEGER NOT NULL,"
+    "    user_id INTEGER,"
+    "    json TEXT NOT NULL);"
+    "CREATE INDEX IF NOT EXISTS comments_status_id ON comments (status_id);"
+    "PRAGMA user_version = " G_STRINGIFY (STORE_VERSION) ";";
+
+static const gchar DROP_TABLES[] =
+    "DROP TABLE IF EXISTS statuses;"
+    "DROP TABLE IF EXISTS users;"
+    "DROP TABLE IF EXISTS comments;";
+
+static const gchar CLEAR_TABLES[] =
+    "DELETE FROM statuses;"
+    "DELETE FROM users;"
+    "DELETE FROM comments;";
+
+/* A post seen in the home timeline stays there when it is seen again
+ * as a reposted one. */
+static const gchar INSERT_STATUS[] =
+    "INSERT INTO statuses (id, user_id, retweeted_id, home, json)"
+    " VALUES (?1, ?2, ?3, ?4, ?5)"
+    " ON CONFLICT (id) DO UPDATE SET json = excluded.json,"
+    "                                home = MAX (home, excluded.home)";
+
+/* Users come along with every post and comment of theirs, keep the
+ * profile from the newest one. */
+static const gchar INSERT_USER[] =
+    "INSERT INTO users (id, seen_id, json) VALUES (?1, ?2, ?3)"
+    " ON CONFLICT (id) DO UPDATE SET seen_id = excluded.seen_id,"
+    "                                json = excluded.json"
+    " WHERE excluded.seen_id >= users.seen_id";
+
+/* Posts left out of the home timeline are kept as long as they are
+ * reposted, like any other. */
+static const gchar RESET_HOME_TIMELINE[] =
+    "UPDATE statuses SET home = 0 WHERE home = 1";
+
+static const gchar INSERT_COMMENT[] =
+    "INSERT OR REPLACE INTO comments (id, status_id, user_id, json)"
+    " VALUES (?1, ?2, ?3, ?4)";
+
+/* Only the newest posts of the home timeline are kept, along with
+ * what they repost, their comments and the users of all of them. */
+static const gchar PRUNE_HOME_TIMELINE[] =
+    "DELETE FROM statuses WHERE home = 1 AND id NOT IN"
+    "    (SELECT id FROM statuses WHERE home = 1 ORDER BY id DESC LIMIT ?1)";
+
+static const gchar PRUNE[] =
+    "DELETE FROM statuses WHERE home = 0 AND id NOT IN"
+    "    (SELECT retweeted_id FROM statuses WHERE retweeted_id IS NOT NULL);"
+    "DELETE FROM comments WHERE status_id NOT IN (SELECT id FROM statuses);"
+    "DELETE FROM users WHERE id NOT IN"
+    "    (SELECT user_id FROM statuses WHERE user_id IS NOT NULL"
+    "     UNION SELECT user_id FROM comments WHERE user_id IS NOT NULL);";
+
+static const gchar SELECT_HOME_TIMELINE[] =
+    "SELECT json FROM statuses WHERE home = 1 ORDER BY id DESC LIMIT ?1";
+
+static const gchar SELECT_COMMENTS[] =
+    "SELECT json FROM comments WHERE status_id = ?1 ORDER BY id";
+
+static const gchar SELECT_USER[] =
+    "SELECT json FROM users WHERE id = ?1";
+
+struct _WbStore
+{
+    GObject parent_instance;
+};
+
+typedef struct
+{
+    /* Only used by the writer thread, once opened. */
+    sqlite3 *db;
+    /* Opened in serialized mode, it is shared by the threads loading
+     * from the store. In WAL mode they don't wait for the writer. */
+    sqlite3 *read_db;
+    /* Writes are done in a single thread, in the order they were
+     * requested, so that the UI never waits for the disk. */
+    GThreadPool *writer;
+    GSettings *settings;
+    /* Read by the writer thread. */
+    gint stored_posts;
+} WbStorePrivate;
+
+typedef enum
+{
+    WB_STORE_JOB_HOME_TIMELINE,
+    WB_STORE_JOB_REPLACE_HOME_TIMELINE,
+    WB_STORE_JOB_COMMENTS,
+    WB_STORE_JOB_CLEAR
+} WbStoreJobType;
+
+typedef struct
+{
+    WbStoreJobType type;
+    /* The JSON data of the posts or comments, parsed again in the
+     * writer thread, which shares no JSON nodes with any other. */
+    GPtrArray *json;
+} WbStoreJob;
+
+typedef struct
+{
+    sqlite3_stmt *insert_status;
+    sqlite3_stmt *insert_user;
+    sqlite3_stmt *insert_comment;
+} WbStoreStatements;
+
+/* Builds a post, a comment or a user out of its JSON data. */
+typedef gpointer (*WbStoreNewFunc) (JsonObject *object);
+
+/* Posts or comments loaded from the store, and the latest profile of
+ * their authors. */
+typedef struct
+{
+    GPtrArray *objects;
+    GPtrArray *users;
+} WbStoreLoadResult;
+
+G_DEFINE_TYPE_WITH_PRIVATE (WbStore, wb_store, G_TYPE_OBJECT)
+
+static gboolean
+wb_store_exec (WbStore *self,
+               const gchar *sql)
+{
+    gchar *message = NULL;
+    WbStorePrivate *priv = wb_store_get_instance_private (self);
+
+    if (sqlite3_exec (priv->db, sql, NULL, NULL, &message) != SQLITE_OK)
+    {
+        g_warning ("Failed to update the store: %s", message);
+        sqlite3_free (message);
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+wb_store_job_free (WbStoreJob *job)
+{
+    if (job->json != NULL)
+    {
+        g_ptr_array_unref (job->json);
+    }
+
+    g_slice_free (WbStoreJob, job);
+}
+
+/* Takes @json. */
+static void
+wb_store_push_job (WbStore *self,
+                   WbStoreJobType type,
+                   GPtrArray *json)
+{
+    WbStoreJob *job;
+    WbStorePrivate *priv = wb_store_get_instance_private (self);
+
+    job = g_slice_new (WbStoreJob);
+    job->type = type;
+    job->json = json;
+
+    g_thread_pool_push (priv->writer, job, NULL);
+}
+
+/* Run @stmt, which returns no rows, and get it ready for the next
+ * one. */
+static gboolean
+wb_store_step (sqlite3_stmt *stmt)
+{
+    gboolean done;
+
+    done = sqlite3_step (stmt) == SQLITE_DONE;
+    sqlite3_reset (stmt);
+
+    return done;
+}
+
+static gboolean
+wb_store_write_user (WbStoreStatements *statements,
+                     JsonNode *node,
+                     gint64 seen_id)
+{
+    JsonObject *object;
+    sqlite3_stmt *stmt = statements->insert_user;
+
+    object = json_node_get_object (node);
+
+    sqlite3_bind_int64 (stmt, 1, json_object_get_int_member (object, "id"));
+    sqlite3_bind_int64 (stmt, 2, seen_id);
+    sqlite3_bind_text (stmt, 3, json_to_string (node, FALSE), -1, g_free);
+
+    return wb_store_step (stmt);
+}
+
+/* Write the post of @node and get its ID into @id. */
+static gboolean
+wb_store_write_status (WbStoreStatements *statements,
+                       JsonNode *node,
+                       gboolean home,
+                       gint64 *id)
+{
+    gint64 user_id = 0;
+    gint64 retweeted_id = 0;
+    JsonNode *member;
+    JsonObject *object;
+    sqlite3_stmt *stmt = statements->insert_status;
+
+    object = json_node_get_object (node);
+    *id = json_object_get_int_member (object, "id");
+
+    /* Deleted posts which were reposted come without a user. */
+    member = json_object_get_member (object, "user");
+    if (member != NULL && JSON_NODE_HOLDS_OBJECT (member))
+    {
+        if (!wb_store_write_user (statements, member, *id))
+        {
+            return FALSE;
+        }
+        user_id = json_object_get_int_member (json_node_get_object (member),
+                                              "id");
+    }
+
+    /* Written first, the statement is shared with it. */
+    member = json_object_get_member (object, "retweeted_status");
+    if (member != NULL && JSON_NODE_HOLDS_OBJECT (member) &&
+        !wb_store_write_status (statements, member, FALSE, &retweeted_id))
+    {
+        return FALSE;
+    }
+
+    sqlite3_bind_int64 (stmt, 1, *id);
+    if (user_id != 0)
+    {
+        sqlite3_bind_int64 (stmt, 2, user_id);
+    }
+    else
+    {
+        sqlite3_bind_null (stmt, 2);
+    }
+    if (retweeted_id != 0)
+    {
+        sqlite3_bind_int64 (stmt, 3, retweeted_id);
+    }
+    else
+    {
+        sqlite3_bind_null (stmt, 3);
+    }
+    sqlite3_bind_int (stmt, 4, home);
+    sqlite3_bind_text (stmt, 5, json_to_string (node, FALSE), -1, g_free);
+
+    return wb_store_step (stmt);
+}
+
+static gboolean
+wb_store_write_comment (WbStoreStatements *statements,
+                        JsonNode *node)
+{
+    gint64 id;
+    JsonNode *member;
+    JsonObject *object;
+    sqlite3_stmt *stmt = statements->insert_comment;
+
+    object = json_node_get_object (node);
+    id = json_object_get_int_member (object, "id");
+
+    /* Comments are looked up by the post they belong to. */
+    member = json_object_get_member (object, "status");
+    if (member == NULL || !JSON_NODE_HOLDS_OBJECT (member))
+    {
+        return TRUE;
+    }
+
+    sqlite3_bind_int64 (stmt, 1, id);
+    sqlite3_bind_int64 (stmt, 2,
+                        json_object_get_int_member (json_node_get_object (member),
+                                                    "id"));
+
+    member = json_object_get_member (object, "user");
+    if (member != NULL && JSON_NODE_HOLDS_OBJECT (member))
+    {
+        if (!wb_store_write_user (statements, member, id))
+        {
+            return FALSE;
+        }
+        sqlite3_bind_int64 (stmt, 3,
+                            json_object_get_int_member (json_node_get_object (member),
+                                                        "id"));
+    }
+    else
+    {
+        sqlite3_bind_null (stmt, 3);
+    }
+
+    sqlite3_bind_text (stmt, 4, json_to_string (node, FALSE), -1, g_free);
+
+    return wb_store_step (stmt);
+}
+
+static void
+write_thread (gpointer data,
+              gpointer user_data)
+{
+    guint i;
+    gboolean saved;
+    JsonParser *parser = NULL;
+    WbStore *self = WB_STORE (user_data);
+    WbStoreJob *job = data;
+    WbStorePrivate *priv = wb_store_get_instance_private (self);
+    WbStoreStatements statements = { NULL, NULL, NULL };
+
+    if (job->type == WB_STORE_JOB_CLEAR)
+    {
+        wb_store_exec (self, CLEAR_TABLES);
+        wb_store_job_free (job);
+
+        return;
+    }
+
+    if (sqlite3_prepare_v2 (priv->db, INSERT_STATUS, -1,
+                            &statements.insert_status, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2 (priv->db, INSERT_USER, -1,
+                            &statements.insert_user, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2 (priv->db, INSERT_COMMENT, -1,
+                            &statements.insert_comment, NULL) != SQLITE_OK)
+    {
+        g_warning ("Failed to update the store: %s", sqlite3_errmsg (priv->db));
+        goto out;
+    }
+
+    /* A single transaction per page, committing each row would sync
+     * the disk as many times. */
+    if (!wb_store_exec (self, "BEGIN"))
+    {
+        goto out;
+    }
+
+    /* The posts recorded before are older than a gap which is never
+     * fetched, they are not shown again. */
+    saved = job->type != WB_STORE_JOB_REPLACE_HOME_TIMELINE ||
+            wb_store_exec (self, RESET_HOME_TIMELINE);
+
+    parser = json_parser_new ();
+
+    for (i = 0; saved && i < job->json->len; i++)
+    {
+        JsonNode *node;
+
+        if (!json_parser_load_from_data (parser,
+                                         g_ptr_array_index (job->json, i),
+                                         -1, NULL))
+        {
+            continue;
+        }
+
+        node = json_parser_get_root (parser);
+        if (!JSON_NODE_HOLDS_OBJECT (node))
+        {
+            continue;
+        }
+
+        if (job->type == WB_STORE_JOB_COMMENTS)
+        {
+            saved = wb_store_write_comment (&statements, node);
+        }
+        else
+        {
+            gint64 id;
+
+            saved = wb_store_write_status (&statements, node, TRUE, &id);
+        }
+
+        if (!saved)
+        {
+            g_warning ("Failed to update the store: %s",
+                       sqlite3_errmsg (priv->db));
+        }
+    }
+
+    if (saved && job->type != WB_STORE_JOB_COMMENTS)
+    {
+        sqlite3_stmt *stmt;
+
+        if (sqlite3_prepare_v2 (priv->db, PRUNE_HOME_TIMELINE, -1,
+                                &stmt, NULL) == SQLITE_OK)
+        {
+            sqlite3_bind_int64 (stmt, 1, g_atomic_int_get (&priv->stored_posts));
+            saved = sqlite3_step (stmt) == SQLITE_DONE;
+        }
+        else
+        {
+            saved = FALSE;
+        }
+
+        if (!saved)
+        {
+            g_warning ("Failed to update the store: %s",
+                       sqlite3_errmsg (priv->db));
+        }
+        sqlite3_finalize (stmt);
+
+        saved = saved && wb_store_exec (self, PRUNE);
+    }
+
+    /* Half a page would leave a gap in the posts recorded. A failed
+     * COMMIT may leave the transaction open as well. */
+    if (!(saved && wb_store_exec (self, "COMMIT")) &&
+        !sqlite3_get_autocommit (priv->db))
+    {
+        wb_store_exec (self, "ROLLBACK");
+    }
+
+out:
+    g_clear_object (&parser);
+    sqlite3_finalize (statements.insert_status);
+    sqlite3_finalize (statements.insert_user);
+    sqlite3_finalize (statements.insert_comment);
+
+    wb_store_job_free (job);
+}
+
+static void
+wb_store_push_home_timeline (WbStore *self,
+                             WbStoreJobType type,
+                             WbTweetItem **items,
+                             guint n_items)
+{
+    guint i;
+    GPtrArray *json;
+    WbStorePrivate *priv = wb_store_get_instance_private (self);
+
+    /* Only recorded once, the data isn't needed afterwards. */
+    json = g_ptr_array_new_with_free_func (g_free);
+    for (i = 0; i < n_items; i++)
+    {
+        if (items[i]->json != NULL)
+        {
+            g_ptr_array_add (json, g_steal_pointer (&items[i]->json));
+        }
+    }
+
+    if ((json->len == 0 && type == WB_STORE_JOB_HOME_TIMELINE) ||
+        priv->db == NULL || g_atomic_int_get (&priv->stored_posts) == 0)
+    {
+        g_ptr_array_unref (json);
+        return;
+    }
+
+    wb_store_push_job (self, type, json);
+}
+
+/**
+ * wb_store_save_home_timeline:
+ * @self: a #WbStore
+ * @items: (array length=n_items): posts shown at the top or the end of
+ * the home timeline, next to the ones recorded already
+ * @n_items: number of posts in @items
+ *
+ * Record the posts of @items which were just fetched using Weibo API,
+ * their authors and the posts they repost. Only the newest posts are
+ * kept, according to the "stored-posts" setting.
+ *
+ * The data of the posts is written to disk in the background.
+ */
+void
+wb_store_save_home_timeline (WbStore *self,
+                             WbTweetItem **items,
+                             guint n_items)
+{
+    g_return_if_fail (WB_IS_STORE (self));
+
+    wb_store_push_home_timeline (self, WB_STORE_JOB_HOME_TIMELINE,
+                                 items, n_items);
+}
+
+/**
+ * wb_store_replace_home_timeline:
+ * @self: a #WbStore
+ * @items: (array length=n_items): posts the home timeline starts over
+ * with
+ * @n_items: number of posts in @items
+ *
+ * Like wb_store_save_home_timeline(), but the posts recorded before are
+ * no longer part of the home timeline, when a gap between them and
+ * @items was left unfetched.
+ */
+void
+wb_store_replace_home_timeline (WbStore *self,
+                                WbTweetItem **items,
+                                guint n_items)
+{
+    g_return_if_fail (WB_IS_STORE (self));
+
+    wb_store_push_home_timeline (self, WB_STORE_JOB_REPLACE_HOME_TIMELINE,
+                                 items, n_items);
+}
+
+/**
+ * wb_store_save_comments:
+ * @self: a #WbStore
+ * @comments: (array length=n_comments): comments shown
+ * @n_comments: number of comments in @comments
+ *
+ * Record the comments of @comments which were just fetched using Weibo
+ * API and their authors, the same way as wb_store_save_home_timeline().
+ * Comments are kept as long as the post they belong to.
+ */
+void
+wb_store_save_comments (WbStore *self,
+                        WbComment **comments,
+                        guint n_comments)
+{
+    guint i;
+    GPtrArray *json;
+    WbStorePrivate *priv;
+
+    g_return_if_fail (WB_IS_STORE (self));
+
+    priv = wb_store_get_instance_private (self);
+
+    json = g_ptr_array_new_with_free_func (g_free);
+    for (i = 0; i < n_comments; i++)
+    {
+        if (comments[i]->json != NULL)
+        {
+            g_ptr_array_add (json, g_steal_pointer (&comments[i]->json));
+        }
+    }
+
+    if (json->len == 0 || priv->db == NULL ||
+        g_atomic_int_get (&priv->stored_posts) == 0)
+    {
+        g_ptr_array_unref (json);
+        return;
+    }
+
+    wb_store_push_job (self, WB_STORE_JOB_COMMENTS, json);
+}
+
+static void
+wb_store_load_result_free (WbStoreLoadResult *result)
+{
+    g_ptr_array_unref (result->objects);
+    g_ptr_array_unref (result->users);
+
+    g_slice_free (WbStoreLoadResult, result);
+}
+
+/* Parse the JSON data of each row of @stmt. */
+static void
+wb_store_load_rows (sqlite3_stmt *stmt,
+                    JsonParser *parser,
+                    WbStoreNewFunc new_func,
+                    GPtrArray *objects)
+{
+    while (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+        JsonNode *root_node;
+
+        if (!json_parser_load_from_data (parser,
+                                         (const gchar *) sqlite3_column_text (stmt, 0),
+                                         sqlite3_column_bytes (stmt, 0), NULL))
+        {
+            continue;
+        }
+
+        root_node = json_parser_get_root (parser);
+        if (JSON_NODE_HOLDS_OBJECT (root_node))
+        {
+            g_ptr_array_add (objects, new_func (json_node_get_object (root_node)));
+        }
+    }
+}
+
+static void
+wb_store_load_user (sqlite3_stmt *stmt,
+                    JsonParser *parser,
+                    WbUser *user,
+                    GHashTable *seen,
+                    GPtrArray *users)
+{
+    if (user == NULL || g_hash_table_contains (seen, &user->id))
+    {
+        return;
+    }
+
+    g_hash_table_add (seen, &user->id);
+
+    sqlite3_bind_int64 (stmt, 1, user->id);
+    wb_store_load_rows (stmt, parser, (WbStoreNewFunc) wb_user_new, users);
+    sqlite3_reset (stmt);
+}
+
+static void
+load_thread (GTask *task,
+             gpointer source_object,
+             gpointer task_data,
+             GCancellable *cancellable)
+{
+    guint i;
+    gpointer source_tag;
+    GHashTable *seen;
+    JsonParser *parser;
+    sqlite3_stmt *stmt = NULL;
+    WbStore *self = WB_STORE (source_object);
+    WbStoreLoadResult *result;
+    WbStorePrivate *priv = wb_store_get_instance_private (self);
+
+    source_tag = g_task_get_source_tag (task);
+
+    result = g_slice_new (WbStoreLoadResult);
+    result->objects = g_ptr_array_new_with_free_func (g_object_unref);
+    result->users = g_ptr_array_new_with_free_func (g_object_unref);
+
+    if (priv->read_db == NULL)
+    {
+        g_task_return_pointer (task, result,
+                               (GDestroyNotify) wb_store_load_result_free);
+        return;
+    }
+
+    parser = json_parser_new ();
+
+    if (source_tag == wb_store_load_home_timeline_async)
+    {
+        if (sqlite3_prepare_v2 (priv->read_db, SELECT_HOME_TIMELINE, -1,
+                                &stmt, NULL) == SQLITE_OK)
+        {
+            sqlite3_bind_int64 (stmt, 1, *(gint64 *) task_data);
+            wb_store_load_rows (stmt, parser, (WbStoreNewFunc) wb_tweet_item_new,
+                                result->objects);
+        }
+    }
+    else
+    {
+        if (sqlite3_prepare_v2 (priv->read_db, SELECT_COMMENTS, -1,
+                                &stmt, NULL) == SQLITE_OK)
+        {
+            sqlite3_bind_int64 (stmt, 1, *(gint64 *) task_data);
+            wb_store_load_rows (stmt, parser, (WbStoreNewFunc) wb_comment_new,
+                                result->objects);
+        }
+    }
+    sqlite3_finalize (stmt);
+    stmt = NULL;
+
+    /* The users embedded in older posts and comments are outdated. */
+    seen = g_hash_table_new (g_int64_hash, g_int64_equal);
+    if (sqlite3_prepare_v2 (priv->read_db, SELECT_USER, -1, &stmt, NULL) == SQLITE_OK)
+    {
+        for (i = 0; i < result->objects->len; i++)
+        {
+            gpointer object = g_ptr_array_index (result->objects, i);
+
+            if (WB_IS_TWEET_ITEM (object))
+            {
+                WbTweetItem *tweet_item = object;
+
+                wb_store_load_user (stmt, parser, tweet_item->user,
+                                    seen, result->users);
+                if (tweet_item->retweeted_item != NULL)
+                {
+                    wb_store_load_user (stmt, parser,
+                                        tweet_item->retweeted_item->user,
+                                        seen, result->users);
+                }
+            }
+            else
+            {
+                wb_store_load_user (stmt, parser,
+                                    WB_COMMENT (object)->user,
+                                    seen, result->users);
+            }
+        }
+    }
+    sqlite3_finalize (stmt);
+
+    g_hash_table_destroy (seen);
+    g_object_unref (parser);
+
+    g_task_return_pointer (task, result,
+                           (GDestroyNotify) wb_store_load_result_free);
+}
+
+static void
+wb_store_load_async (WbStore *self,
+                     gint64 key,
+                     GCancellable *cancellable,
+                     GAsyncReadyCallback callback,
+                     gpointer user_data,
+                     gpointer source_tag)
+{
+    gint64 *data;
+    GTask *task;
+
+    data = g_new (gint64, 1);
+    *data = key;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_source_tag (task, source_tag);
+    g_task_set_task_data (task, data, g_free);
+    g_task_run_in_thread (task, load_thread);
+    g_object_unref (task);
+}
+
+/* Share the loaded objects and users through the #WbEntityStore, the
+ * same way as the ones fetched using Weibo API. */
+static GPtrArray *
+wb_store_load_finish (WbStore *self,
+                      GAsyncResult *result,
+                      gpointer source_tag,
+                      GError **error)
+{
+    guint i;
+    GPtrArray *objects;
+    WbEntityStore *entity_store;
+    WbStoreLoadResult *load_result;
+
+    g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+    g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == source_tag,
+                          NULL);
+
+    load_result = g_task_propagate_pointer (G_TASK (result), error);
+    if (load_result == NULL)
+    {
+        return NULL;
+    }
+
+    objects = g_ptr_array_ref (load_result->objects);
+
+    entity_store = wb_application_get_entity_store (WB_APPLICATION (g_application_get_default ()));
+    for (i = 0; i < objects->len; i++)
+    {
+        gpointer object = g_ptr_array_index (objects, i);
+
+        if (WB_IS_TWEET_ITEM (object))
+        {
+            objects->pdata[i] = wb_entity_store_intern_status (entity_store,
+                                                               object);
+            g_object_unref (object);
+        }
+        else
+        {
+            wb_entity_store_intern_comment (entity_store, object);
+        }
+    }
+
+    /* The users are in use by now, this updates them. */
+    for (i = 0; i < load_result->users->len; i++)
+    {
+        g_object_unref (wb_entity_store_intern_user (entity_store,
+                                                     g_ptr_array_index (load_result->users, i)));
+    }
+
+    wb_store_load_result_free (load_result);
+
+    return objects;
+}
+
+/**
+ * wb_store_load_home_timeline_async:
+ * @self: a #WbStore
+ * @count: maximum number of posts to load
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: callback to call when the posts are loaded
+ * @user_data: data to pass to @callback
+ *
+ * Load the newest posts of the home timeline recorded, in a worker
+ * thread.
+ */
+void
+wb_store_load_home_timeline_async (WbStore *self,
+                                   guint count,
+                                   GCancellable *cancellable,
+                                   GAsyncReadyCallback callback,
+                                   gpointer user_data)
+{
+    g_return_if_fail (WB_IS_STORE (self));
+
+    wb_store_load_async (self, count, cancellable, callback, user_data,
+                         wb_store_load_home_timeline_async);
+}
+
+/**
+ * wb_store_load_home_timeline_finish:
+ * @self: a #WbStore
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError
+ *
+ * Returns: (transfer full) (element-type WbTweetItem): the posts, newest
+ * first, or %NULL on error
+ */
+GPtrArray *
+wb_store_load_home_timeline_finish (WbStore *self,
+                                    GAsyncResult *result,
+                                    GError **error)
+{
+    return wb_store_load_finish (self, result,
+                                 wb_store_load_home_timeline_async, error);
+}
+
+/**
+ * wb_store_load_comments_async:
+ * @self: a #WbStore
+ * @status_id: id of the post
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: callback to call when the comments are loaded
+ * @user_data: data to pass to @callback
+ *
+ * Load the comments recorded for a post, in a worker thread.
+ */
+void
+wb_store_load_comments_async (WbStore *self,
+                              gint64 status_id,
+                              GCancellable *cancellable,
+                              GAsyncReadyCallback callback,
+                              gpointer user_data)
+{
+    g_return_if_fail (WB_IS_STORE (self));
+
+    wb_store_load_async (self, status_id, cancellable, callback, user_data,
+                         wb_store_load_comments_async);
+}
+
+/**
+ * wb_store_load_comments_finish:
+ * @self: a #WbStore
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError
+ *
+ * Returns: (transfer full) (element-type WbComment): the comments, oldest
+ * first, or %NULL on error
+ */
+GPtrArray *
+wb_store_load_comments_finish (WbStore *self,
+                               GAsyncResult *result,
+                               GError **error)
+{
+    return wb_store_load_finish (self, result,
+                                 wb_store_load_comments_async, error);
+}
+
+static void
+settings_changed_cb (GSettings *settings,
+                     const gchar *key,
+                     gpointer user_data)
+{
+    WbStore *self = WB_STORE (user_data);
+    WbStorePrivate *priv = wb_store_get_instance_private (self);
+
+    if (priv->db == NULL)
+    {
+        return;
+    }
+
+    if (g_strcmp0 (key, STORED_POSTS) == 0)
+    {
+        g_atomic_int_set (&priv->stored_posts,
+                          g_settings_get_uint (settings, STORED_POSTS));
+        if (g_atomic_int_get (&priv->stored_posts) == 0)
+        {
+            wb_store_push_job (self, WB_STORE_JOB_CLEAR, NULL);
+        }
+    }
+    else if (g_strcmp0 (key, UID) == 0)
+    {
+        /* Logged in as someone else, whose timeline is different. */
+        wb_store_push_job (self, WB_STORE_JOB_CLEAR, NULL);
+    }
+}
+
+static void
+wb_store_open (WbStore *self)
+{
+    gint version = 0;
+    g_autofree gchar *dir = NULL;
+    g_autofree gchar *path = NULL;
+    sqlite3_stmt *stmt;
+    WbStorePrivate *priv = wb_store_get_instance_private (self);
+
+    dir = g_build_filename (g_get_user_cache_dir (), "weibird", NULL);
+    g_mkdir_with_parents (dir, 0700);
+    path = g_build_filename (dir, "store.db", NULL);
+
+    if (sqlite3_open_v2 (path, &priv->db,
+                         SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                         NULL) != SQLITE_OK)
+    {
+        g_warning ("Failed to open the store %s: %s",
+                   path, sqlite3_errmsg (priv->db));
+        goto error;
+    }
+
+    if (sqlite3_prepare_v2 (priv->db, "PRAGMA user_version", -1,
+                            &stmt, NULL) == SQLITE_OK)
+    {
+        if (sqlite3_step (stmt) == SQLITE_ROW)
+        {
+            version = sqlite3_column_int (stmt, 0);
+        }
+
+        sqlite3_finalize (stmt);
+    }
+
+    /* Readers don't wait for the writer, and a crash loses at most the
+     * last page written, which is fetched again anyway. */
+    if (!wb_store_exec (self, "PRAGMA journal_mode = WAL;"
+                              "PRAGMA synchronous = NORMAL;") ||
+        (version != STORE_VERSION && !wb_store_exec (self, DROP_TABLES)) ||
+        !wb_store_exec (self, CREATE_TABLES))
+    {
+        goto error;
+    }
+
+    if (sqlite3_open_v2 (path, &priv->read_db,
+                         SQLITE_OPEN_READONLY | SQLITE_OPEN_FULLMUTEX,
+                         NULL) != SQLITE_OK)
+    {
+        g_warning ("Failed to open the store %s: %s",
+                   path, sqlite3_errmsg (priv->read_db));
+        sqlite3_close (priv->read_db);
+        priv->read_db = NULL;
+        goto error;
+    }
+
+    return;
+
+error:
+    sqlite3_close (priv->db);
+    priv->db = NULL;
+}
+
+static void
+wb_store_finalize (GObject *object)
+{
+    WbStore *self = WB_STORE (object);
+    WbStorePrivate *priv = wb_store_get_instance_private (self);
+
+    /* Write what is still queued before closing the store. */
+    g_thread_pool_free (priv->writer, FALSE, TRUE);
+    g_object_unref (priv->settings);
+
+    /* Both accept NULL. */
+    sqlite3_close (priv->db);
+    sqlite3_close (priv->read_db);
+
+    G_OBJECT_CLASS (wb_store_parent_class)->finalize (object);
+}
+
+static void
+wb_store_class_init (WbStoreClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->finalize = wb_store_finalize;
+}
+
+static void
+wb_store_init (WbStore *self)
+{
+    WbStorePrivate *priv = wb_store_get_instance_private (self);
+
+    priv->db = NULL;
+    priv->read_db = NULL;
+    priv->writer = g_thread_pool_new (write_thread, self, 1, FALSE, NULL);
+
+    priv->settings = g_settings_new (SETTINGS_SCHEMA);
+    priv->stored_posts = g_settings_get_uint (priv->settings, STORED_POSTS);
+    g_signal_connect (priv->settings, "changed",
+                      G_CALLBACK (settings_changed_cb), self);
+
+    wb_store_open (self);
+}
+
+/**
+ * wb_store_new:
+ *
+ * Create a new #WbStore, using the store on disk. Without one, nothing
+ * is recorded and nothing is loaded.
+ *
+ * Returns: (transfer full): a newly created #WbStore
+ */
+WbStore *
+wb_store_new (void)
+{
+    return g_object_new (WB_TYPE_STORE, NULL);
+}
@@ -0,0 +1,59 @@
+/*
+ *  Weibird - View and compose weibo
+ *  Copyright (C) 2019 Jonathan Kang <jonathankang@gnome.org>.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "wb-comment.h"
+#include "wb-tweet-item.h"
+
+G_BEGIN_DECLS
+
+#define WB_TYPE_STORE (wb_store_get_type ())
+
+G_DECLARE_FINAL_TYPE (WbStore, wb_store, WB, STORE, GObject)
+
+void wb_store_save_home_timeline (WbStore *self,
+                                  WbTweetItem **items,
+                                  guint n_items);
+void wb_store_replace_home_timeline (WbStore *self,
+                                     WbTweetItem **items,
+                                     guint n_items);
+void wb_store_save_comments (WbStore *self,
+                             WbComment **comments,
+                             guint n_comments);
+void wb_store_load_home_timeline_async (WbStore *self,
+                                        guint count,
+                                        GCancellable *cancellable,
+                                        GAsyncReadyCallback callback,
+                                        gpointer user_data);
+GPtrArray *wb_store_load_home_timeline_finish (WbStore *self,
+                                               GAsyncResult *result,
+                                               GError **error);
+void wb_store_load_comments_async (WbStore *self,
+                                   gint64 status_id,
+                                   GCancellable *cancellable,
+                                   GAsyncReadyCallback callback,
+                                   gpointer user_data);
+GPtrArray *wb_store_load_comments_finish (WbStore *self,
+                                          GAsyncResult *result,
+                                          GError **error);
+WbStore *wb_store_new (void);
+
+G_END_DECLS
@@ -18,237 +18,1454 @@
 
 #include <glib.h>
 #include <gtk/gtk.h>
-#include <json-glib/json-glib.h>
-#include <rest/oauth2-proxy.h>
 
+#include "wb-api-client.h"
+#include "wb-application.h"
 #include "wb-enums.h"
 #include "wb-main-widget.h"
+#include "wb-snapshot.h"
 #include "wb-tweet-item.h"
 #include "wb-tweet-row.h"
 #include "wb-util.h"
 
+/* Rows are only created for the posts in the viewport and a few
+ * around it, the rest of the timeline is stood in for by two spacers. */
+#define OVERSCAN_ROWS 3
+/* Used for posts which were never shown, until some rows are measured. */
+#define ESTIMATED_ROW_HEIGHT 300
+/* Time spent creating rows in each frame, in microseconds. */
+#define FRAME_BUDGET 4000
+/* Rough time it takes to fetch a page of posts, in seconds. The next
+ * page is fetched this long before reaching the end of the timeline at
+ * the current scrolling speed. */
+#define PAGE_FETCH_TIME 1.5
+
+static const gchar SETTINGS_SCHEMA[] = "com.jonathankang.Weibird";
+static const gchar MAX_RESIDENT_POSTS[] = "max-resident-posts";
+static const gchar PREFETCH_DISTANCE[] = "prefetch-distance";
+static const gchar MIN_PAGE_SIZE[] = "min-page-size";
+static const gchar MAX_PAGE_SIZE[] = "max-page-size";
+static const gchar PAGE_DURATION[] = "page-duration";
+static const gchar SNAPSHOT_POSTS[] = "snapshot-posts";
+static const gchar UID[] = "uid";
+
 enum
 {
     LOADED,
     LAST_SIGNAL
 };
 
-struct _WbTimelineList
-{
-    /*< private >*/
-    GtkBox parent_instance;
-};
+struct _WbTimelineList
+{
+    /*< private >*/
+    GtkBox parent_instance;
+};
+
+typedef struct
+{
+    gint batch_fetched;
+    gint64 last_id;
+    gchar *last_idstr;
+    GCancellable *cancellable;
+    GtkListBox *timeline_list;
+    GtkWidget *timeline_scrolled;
+    GtkWidget *top_spacer;
+    GtkWidget *bottom_spacer;
+    WbTweetItem *tweet_item;
+    WbTweetItem *retweeted_item;
+    /* Posts of the timeline, in the order they are shown. */
+    GListStore *items;
+    /* The same posts, by id. */
+    GHashTable *ids;
+    /* Height of the row of each post, -1 if it was never shown. */
+    GArray *heights;
+    gint64 known_heights;
+    guint n_known_heights;
+    /* Posts in [window_start, window_end) have a row. */
+    guint window_start;
+    guint window_end;
+    /* The window grows to [target_start, target_end) a few rows per
+     * frame, the rows up to visible_end first. */
+    guint target_start;
+    guint target_end;
+    guint visible_end;
+    guint tick_id;
+    /* Posts were loaded, but not the rows shown of them yet. */
+    gboolean loading;
+    guint update_id;
+    /* Scrolling needed to keep the viewport in place after posts above
+     * it were added or dropped. */
+    gint pending_scroll;
+    GSettings *settings;
+    guint max_resident_posts;
+    /* Posts dropped from the top of the timeline, newest first. */
+    GArray *evicted;
+    gboolean refetching;
+    /* The posts being fetched again are the last ones of evicted. */
+    guint refetch_count;
+    guint refetch_evicted_len;
+    /* The next page of older posts, fetched before it is needed. */
+    gboolean fetching_page;
+    gchar *fetching_max_id;
+    GPtrArray *next_page;
+    guint prefetch_distance;
+    guint min_page_size;
+    guint max_page_size;
+    gdouble page_duration;
+    /* Scrolling speed towards the end, in pixels per second. */
+    gdouble velocity;
+    gdouble last_value;
+    gint64 last_value_time;
+    /* Posts newer than the timeline, fetched a page at a time until
+     * the gap up to it is closed. */
+    gboolean refreshing;
+    gchar *refresh_since_id;
+    GPtrArray *refresh_items;
+    /* The posts recorded last time were loaded, or tried to. */
+    gboolean restored;
+    /* Posts at the top written to the snapshot when going away. */
+    guint snapshot_posts;
+} WbTimelineListPrivate;
+
+/* What is left of a post dropped from the top of the timeline, to
+ * fetch it again and put it back in place. */
+typedef struct
+{
+    gint64 id;
+    gint height;
+} WbEvictedPost;
+
+G_DEFINE_TYPE_WITH_PRIVATE (WbTimelineList, wb_timeline_list, GTK_TYPE_BOX)
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+WbTweetItem *
+wb_timeline_list_get_tweet_item (WbTimelineList *self)
+{
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    g_return_val_if_fail (WB_TIMELINE_LIST (self), NULL);
+
+    return priv->tweet_item;
+}
+
+WbTweetItem *
+wb_timeline_list_get_retweeted_item (WbTimelineList *self)
+{
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    g_return_val_if_fail (WB_TIMELINE_LIST (self), NULL);
+
+    return priv->retweeted_item;
+}
+
+GtkListBox *
+wb_timeline_list_get_listbox (WbTimelineList *self)
+{
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    g_return_val_if_fail (WB_TIMELINE_LIST (self), NULL);
+
+    return priv->timeline_list;
+}
+
+/* Change the posts of the timeline, keeping their ids in sync. */
+static void
+wb_timeline_list_splice (WbTimelineList *self,
+                         guint position,
+                         guint n_removals,
+                         gpointer *additions,
+                         guint n_additions)
+{
+    guint i;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    for (i = position; i < position + n_removals; i++)
+    {
+        WbTweetItem *tweet_item;
+
+        tweet_item = g_list_model_get_item (G_LIST_MODEL (priv->items), i);
+        g_hash_table_remove (priv->ids, &tweet_item->id);
+        g_object_unref (tweet_item);
+    }
+
+    for (i = 0; i < n_additions; i++)
+    {
+        WbTweetItem *tweet_item = additions[i];
+
+        g_hash_table_insert (priv->ids, &tweet_item->id, tweet_item);
+    }
+
+    g_list_store_splice (priv->items, position, n_removals,
+                         additions, n_additions);
+}
+
+/* Record posts put in the timeline, next to the ones recorded before,
+ * so that what is on disk has no gaps either. */
+static void
+wb_timeline_list_save (WbTimelineList *self,
+                       gpointer *items,
+                       guint n_items)
+{
+    WbStore *store;
+
+    store = wb_application_get_store (WB_APPLICATION (g_application_get_default ()));
+    wb_store_save_home_timeline (store, (WbTweetItem **) items, n_items);
+}
+
+/* Drop the posts of @items which are in the timeline already, newer
+ * counts are shown on their rows instead. */
+static void
+wb_timeline_list_drop_duplicates (WbTimelineList *self,
+                                  GPtrArray *items)
+{
+    guint i;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    i = 0;
+    while (i < items->len)
+    {
+        WbTweetItem *tweet_item = g_ptr_array_index (items, i);
+        WbTweetItem *resident;
+
+        resident = g_hash_table_lookup (priv->ids, &tweet_item->id);
+        if (resident != NULL)
+        {
+            wb_tweet_item_update_counts (resident, tweet_item);
+            g_ptr_array_remove_index (items, i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+static gint
+wb_timeline_list_get_row_height (WbTimelineList *self,
+                                 guint position)
+{
+    gint height;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    height = g_array_index (priv->heights, gint, position);
+    if (height >= 0)
+    {
+        return height;
+    }
+
+    /* Guess from the rows which were shown so far. */
+    if (priv->n_known_heights != 0)
+    {
+        return priv->known_heights / priv->n_known_heights;
+    }
+
+    return ESTIMATED_ROW_HEIGHT;
+}
+
+static void
+wb_timeline_list_set_known_height (WbTimelineList *self,
+                                   guint position,
+                                   gint height)
+{
+    gint *cached;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    cached = &g_array_index (priv->heights, gint, position);
+    if (*cached < 0)
+    {
+        priv->n_known_heights++;
+    }
+    else
+    {
+        priv->known_heights -= *cached;
+    }
+    priv->known_heights += height;
+    *cached = height;
+}
+
+/* Remember the height of the rows in the window, so that the spacers
+ * can take their place exactly once they are gone. */
+static void
+wb_timeline_list_measure_rows (WbTimelineList *self)
+{
+    guint i;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    for (i = priv->window_start; i < priv->window_end; i++)
+    {
+        gint height;
+        GtkListBoxRow *row;
+        GtkWidget *header;
+
+        row = gtk_list_box_get_row_at_index (priv->timeline_list,
+                                             i - priv->window_start);
+        height = gtk_widget_get_allocated_height (GTK_WIDGET (row));
+        /* Not allocated yet. */
+        if (height <= 1)
+        {
+            continue;
+        }
+
+        header = gtk_list_box_row_get_header (row);
+        if (header != NULL)
+        {
+            height += gtk_widget_get_allocated_height (header);
+        }
+
+        wb_timeline_list_set_known_height (self, i, height);
+    }
+}
+
+static GtkWidget *
+wb_timeline_list_create_row (WbTimelineList *self,
+                             guint position)
+{
+    WbTweetItem *tweet_item;
+    WbTweetRow *row;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    tweet_item = g_list_model_get_item (G_LIST_MODEL (priv->items), position);
+
+    /* Add retweeted item to the row */
+    if (tweet_item->retweeted_item != NULL)
+    {
+        GtkWidget *retweeted_widget;
+
+        /* TODO: Add WbRetweetedItem class? */
+        retweeted_widget = GTK_WIDGET (wb_tweet_row_new (tweet_item->retweeted_item,
+                                                         NULL, TRUE));
+
+        row = wb_tweet_row_new (tweet_item, tweet_item->retweeted_item, FALSE);
+        wb_tweet_row_insert_retweeted_item (row, retweeted_widget);
+    }
+    else
+    {
+        row = wb_tweet_row_new (tweet_item, NULL, FALSE);
+    }
+
+    g_object_unref (tweet_item);
+
+    return GTK_WIDGET (row);
+}
+
+static void
+wb_timeline_list_clear_window (WbTimelineList *self)
+{
+    GtkListBoxRow *row;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    while ((row = gtk_list_box_get_row_at_index (priv->timeline_list, 0)) != NULL)
+    {
+        gtk_widget_destroy (GTK_WIDGET (row));
+    }
+
+    priv->window_start = 0;
+    priv->window_end = 0;
+}
+
+static void
+wb_timeline_list_update_spacers (WbTimelineList *self)
+{
+    gint top_height;
+    gint bottom_height;
+    guint i;
+    guint n_items;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    n_items = g_list_model_get_n_items (G_LIST_MODEL (priv->items));
+
+    /* The spacers follow the estimate as more rows are measured. */
+    top_height = 0;
+    for (i = 0; i < priv->window_start; i++)
+    {
+        top_height += wb_timeline_list_get_row_height (self, i);
+    }
+    bottom_height = 0;
+    for (i = priv->window_end; i < n_items; i++)
+    {
+        bottom_height += wb_timeline_list_get_row_height (self, i);
+    }
+
+    gtk_widget_set_size_request (priv->top_spacer, -1, top_height);
+    gtk_widget_set_size_request (priv->bottom_spacer, -1, bottom_height);
+}
+
+/* Create rows until the window reaches its target or the time for this
+ * frame is spent, so that a page of posts never drops frames. */
+static gboolean
+insert_rows_tick_cb (GtkWidget *widget,
+                     GdkFrameClock *frame_clock,
+                     gpointer user_data)
+{
+    gboolean done = FALSE;
+    gint64 deadline;
+    WbTimelineList *self = WB_TIMELINE_LIST (widget);
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    deadline = g_get_monotonic_time () + FRAME_BUDGET;
+
+    do
+    {
+        if (priv->window_end < priv->visible_end)
+        {
+            gtk_list_box_insert (priv->timeline_list,
+                                 wb_timeline_list_create_row (self, priv->window_end),
+                                 -1);
+            priv->window_end++;
+        }
+        else if (priv->window_start > priv->target_start)
+        {
+            priv->window_start--;
+            gtk_list_box_insert (priv->timeline_list,
+                                 wb_timeline_list_create_row (self, priv->window_start),
+                                 0);
+        }
+        else if (priv->window_end < priv->target_end)
+        {
+            gtk_list_box_insert (priv->timeline_list,
+                                 wb_timeline_list_create_row (self, priv->window_end),
+                                 -1);
+            priv->window_end++;
+        }
+        else
+        {
+            done = TRUE;
+        }
+    } while (!done && g_get_monotonic_time () < deadline);
+
+    /* The first row of the window gets a separator too, unless it is
+     * the first post. */
+    gtk_list_box_invalidate_headers (priv->timeline_list);
+    wb_timeline_list_update_spacers (self);
+
+    /* The first screenful is ready. */
+    if (priv->loading && priv->window_end >= priv->visible_end)
+    {
+        priv->loading = FALSE;
+        g_signal_emit (self, signals[LOADED], 0);
+    }
+
+    if (done)
+    {
+        priv->tick_id = 0;
+
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* Destroy the rows which left the window right away, rows which
+ * scrolled into it are created by insert_rows_tick_cb(). */
+static void
+wb_timeline_list_move_window (WbTimelineList *self,
+                              guint start,
+                              guint first,
+                              guint last,
+                              guint end)
+{
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    if (start >= priv->window_end || end <= priv->window_start)
+    {
+        /* Start from the first post in the viewport. */
+        wb_timeline_list_clear_window (self);
+        priv->window_start = MIN (first, end);
+        priv->window_end = priv->window_start;
+    }
+
+    while (priv->window_start < start)
+    {
+        GtkListBoxRow *row;
+
+        row = gtk_list_box_get_row_at_index (priv->timeline_list, 0);
+        priv->window_start++;
+        gtk_widget_destroy (GTK_WIDGET (row));
+    }
+    while (priv->window_end > end)
+    {
+        GtkListBoxRow *row;
+
+        priv->window_end--;
+        row = gtk_list_box_get_row_at_index (priv->timeline_list,
+                                             priv->window_end - priv->window_start);
+        gtk_widget_destroy (GTK_WIDGET (row));
+    }
+
+    priv->target_start = start;
+    priv->target_end = end;
+    priv->visible_end = MIN (last, end);
+
+    if (priv->tick_id == 0 &&
+        (priv->window_start > start || priv->window_end < end))
+    {
+        priv->tick_id = gtk_widget_add_tick_callback (GTK_WIDGET (self),
+                                                      insert_rows_tick_cb,
+                                                      NULL, NULL);
+    }
+}
+
+/* Drop the posts furthest from the viewport once there are too many of
+ * them. The ones at the bottom are fetched again like any older posts,
+ * the ones at the top by wb_timeline_list_refetch(). */
+static void
+wb_timeline_list_evict (WbTimelineList *self)
+{
+    guint i;
+    guint n_items;
+    guint n_evict;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    n_items = g_list_model_get_n_items (G_LIST_MODEL (priv->items));
+    if (priv->max_resident_posts == 0 || n_items <= priv->max_resident_posts)
+    {
+        return;
+    }
+
+    n_evict = n_items - priv->max_resident_posts;
+
+    if (priv->window_start >= n_items - priv->window_end)
+    {
+        gint height = 0;
+
+        /* Rows in the window stay. */
+        n_evict = MIN (n_evict, priv->window_start);
+        if (n_evict == 0)
+        {
+            return;
+        }
+
+        for (i = 0; i < n_evict; i++)
+        {
+            WbEvictedPost post;
+            WbTweetItem *tweet_item;
+
+            tweet_item = g_list_model_get_item (G_LIST_MODEL (priv->items), i);
+            post.id = tweet_item->id;
+            post.height = g_array_index (priv->heights, gint, i);
+            g_array_append_val (priv->evicted, post);
+            g_object_unref (tweet_item);
+
+            height += wb_timeline_list_get_row_height (self, i);
+        }
+
+        priv->pending_scroll -= height;
+        wb_timeline_list_splice (self, 0, n_evict, NULL, 0);
+    }
+    else
+    {
+        WbTweetItem *tweet_item;
+
+        n_evict = MIN (n_evict, n_items - priv->window_end);
+        if (n_evict == 0)
+        {
+            return;
+        }
+
+        wb_timeline_list_splice (self, n_items - n_evict, n_evict, NULL, 0);
+
+        /* Load more posts from the new end of the timeline. The page
+         * fetched for the old end doesn't follow it anymore. */
+        g_clear_pointer (&priv->next_page, g_ptr_array_unref);
+        tweet_item = g_list_model_get_item (G_LIST_MODEL (priv->items),
+                                            n_items - n_evict - 1);
+        priv->last_id = tweet_item->id;
+        g_free (priv->last_idstr);
+        priv->last_idstr = wb_tweet_item_dup_idstr (tweet_item);
+        g_object_unref (tweet_item);
+    }
+}
+
+static void
+statuses_refetched_cb (GObject *source_object,
+                       GAsyncResult *result,
+                       gpointer user_data)
+{
+    gint height;
+    guint i;
+    guint j;
+    guint n_evicted;
+    GError *error = NULL;
+    GPtrArray *items;
+    WbTimelineList *self;
+    WbTimelineListPrivate *priv;
+
+    items = wb_api_client_get_home_timeline_finish (WB_API_CLIENT (source_object),
+                                                    result, &error);
+    if (items == NULL)
+    {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_error_free (error);
+            return;
+        }
+
+        g_warning ("%s", error->message);
+        g_error_free (error);
+
+        self = WB_TIMELINE_LIST (user_data);
+        priv = wb_timeline_list_get_instance_private (self);
+        priv->refetching = FALSE;
+
+        return;
+    }
+
+    self = WB_TIMELINE_LIST (user_data);
+    priv = wb_timeline_list_get_instance_private (self);
+
+    priv->refetching = FALSE;
+
+    /* More posts were dropped in the meantime, the page doesn't fit at
+     * the top of the timeline anymore. */
+    if (priv->evicted->len != priv->refetch_evicted_len)
+    {
+        g_ptr_array_unref (items);
+        return;
+    }
+
+    wb_timeline_list_drop_duplicates (self, items);
+    wb_timeline_list_splice (self, 0, 0, items->pdata, items->len);
+    wb_timeline_list_save (self, items->pdata, items->len);
+
+    /* Put the posts back the way they were shown. */
+    n_evicted = priv->refetch_count;
+    height = 0;
+    for (i = 0; i < items->len; i++)
+    {
+        WbTweetItem *tweet_item = g_ptr_array_index (items, i);
+
+        for (j = priv->evicted->len - n_evicted; j < priv->evicted->len; j++)
+        {
+            WbEvictedPost *post;
+
+            post = &g_array_index (priv->evicted, WbEvictedPost, j);
+            if (post->id == tweet_item->id && post->height >= 0)
+            {
+                wb_timeline_list_set_known_height (self, i, post->height);
+                break;
+            }
+        }
+
+        height += wb_timeline_list_get_row_height (self, i);
+    }
+
+    /* Posts deleted in the meantime are not coming back either. */
+    g_array_set_size (priv->evicted, priv->evicted->len - n_evicted);
+    priv->pending_scroll += height;
+
+    g_ptr_array_unref (items);
+}
+
+/* Fetch the posts right above the top of the timeline again, after
+ * they were dropped by wb_timeline_list_evict(). */
+static void
+wb_timeline_list_refetch (WbTimelineList *self)
+{
+    g_autofree gchar *since_id = NULL;
+    g_autofree gchar *max_id = NULL;
+    guint n_evicted;
+    WbApiClient *client;
+    WbEvictedPost *post;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    if (priv->refetching || priv->evicted->len == 0)
+    {
+        return;
+    }
+
+    n_evicted = MIN (priv->max_page_size, priv->evicted->len);
+    post = &g_array_index (priv->evicted, WbEvictedPost,
+                           priv->evicted->len - n_evicted);
+    max_id = g_strdup_printf ("%" G_GINT64_FORMAT, post->id);
+
+    if (g_list_model_get_n_items (G_LIST_MODEL (priv->items)) != 0)
+    {
+        WbTweetItem *tweet_item;
+
+        tweet_item = g_list_model_get_item (G_LIST_MODEL (priv->items), 0);
+        since_id = wb_tweet_item_dup_idstr (tweet_item);
+        g_object_unref (tweet_item);
+    }
+
+    priv->refetching = TRUE;
+    priv->refetch_count = n_evicted;
+    priv->refetch_evicted_len = priv->evicted->len;
+
+    client = wb_application_get_api_client (WB_APPLICATION (g_application_get_default ()));
+    wb_api_client_get_home_timeline_async (client, since_id, max_id,
+                                           n_evicted, priv->cancellable,
+                                           statuses_refetched_cb, self);
+}
+
+static void
+wb_timeline_list_append_page (WbTimelineList *self,
+                              GPtrArray *items)
+{
+    guint i;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    /* The post at max_id is part of the page, like any other post
+     * fetched before. */
+    wb_timeline_list_drop_duplicates (self, items);
+
+    for (i = 0; i < items->len; i++)
+    {
+        WbTweetItem *tweet_item = g_ptr_array_index (items, i);
+
+        if (priv->last_idstr == NULL || tweet_item->id < priv->last_id)
+        {
+            priv->last_id = tweet_item->id;
+            g_free (priv->last_idstr);
+            priv->last_idstr = wb_tweet_item_dup_idstr (tweet_item);
+        }
+    }
+
+    /* The posts were built in a worker thread already, only the rows
+     * in the window are created here. */
+    wb_timeline_list_splice (self,
+                             g_list_model_get_n_items (G_LIST_MODEL (priv->items)),
+                             0, items->pdata, items->len);
+    wb_timeline_list_save (self, items->pdata, items->len);
+
+    priv->batch_fetched++;
+
+    /* Only hidden lists can't show the posts right away. */
+    if (gtk_widget_get_mapped (GTK_WIDGET (self)))
+    {
+        priv->loading = TRUE;
+    }
+    else
+    {
+        g_signal_emit (self, signals[LOADED], 0);
+    }
+}
+
+static void
+wb_timeline_list_insert_next_page (WbTimelineList *self)
+{
+    GPtrArray *items;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    items = g_steal_pointer (&priv->next_page);
+    wb_timeline_list_append_page (self, items);
+    g_ptr_array_unref (items);
+}
+
+/* Fetch the next page before the end of the timeline is reached, sooner
+ * the faster it is scrolled, and insert it once it is about to be
+ * shown. */
+static void
+wb_timeline_list_prefetch (WbTimelineList *self,
+                           gdouble distance,
+                           gdouble page_size)
+{
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    /* The first page is not there yet. */
+    if (priv->batch_fetched == 0)
+    {
+        return;
+    }
+
+    if (priv->next_page != NULL)
+    {
+        if (distance < page_size)
+        {
+            wb_timeline_list_insert_next_page (self);
+        }
+    }
+    else if (distance < priv->prefetch_distance + priv->velocity * PAGE_FETCH_TIME)
+    {
+        wb_timeline_list_get_home_timeline (self, TRUE);
+    }
+}
+
+/* Move the window to the posts in the viewport. */
+static void
+wb_timeline_list_update_window (WbTimelineList *self)
+{
+    gint y;
+    gint64 now;
+    gdouble top;
+    gdouble bottom;
+    guint i;
+    guint n_items;
+    guint first;
+    guint last;
+    guint start;
+    guint end;
+    GtkAdjustment *adjustment;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    n_items = g_list_model_get_n_items (G_LIST_MODEL (priv->items));
+    adjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (priv->timeline_scrolled));
+
+    if (priv->pending_scroll != 0)
+    {
+        /* The spacer above is resized below, make room for it first. */
+        gtk_adjustment_configure (adjustment,
+                                  gtk_adjustment_get_value (adjustment) + priv->pending_scroll,
+                                  gtk_adjustment_get_lower (adjustment),
+                                  gtk_adjustment_get_upper (adjustment) + priv->pending_scroll,
+                                  gtk_adjustment_get_step_increment (adjustment),
+                                  gtk_adjustment_get_page_increment (adjustment),
+                                  gtk_adjustment_get_page_size (adjustment));
+        priv->pending_scroll = 0;
+    }
+
+    top = gtk_adjustment_get_value (adjustment);
+    bottom = top + gtk_adjustment_get_page_size (adjustment);
+
+    now = g_get_monotonic_time ();
+    if (top != priv->last_value && now > priv->last_value_time)
+    {
+        gdouble velocity;
+
+        velocity = (top - priv->last_value) * G_USEC_PER_SEC
+                   / (now - priv->last_value_time);
+        /* Smooth it a bit, scroll events come in bursts. */
+        priv->velocity = MAX ((priv->velocity + velocity) / 2, 0);
+        priv->last_value = top;
+        priv->last_value_time = now;
+    }
+    else if (now - priv->last_value_time > G_USEC_PER_SEC / 4)
+    {
+        priv->velocity = 0;
+    }
+
+    wb_timeline_list_measure_rows (self);
+
+    /* Find the posts in the viewport. */
+    y = 0;
+    first = n_items;
+    last = n_items;
+    for (i = 0; i < n_items; i++)
+    {
+        gint height;
+
+        if (y >= bottom)
+        {
+            last = i;
+            break;
+        }
+
+        height = wb_timeline_list_get_row_height (self, i);
+        if (first == n_items && y + height > top)
+        {
+            first = i;
+        }
+
+        y += height;
+    }
+    /* Nothing is visible before the list is allocated. */
+    first = MIN (first, last);
+
+    start = first > OVERSCAN_ROWS ? first - OVERSCAN_ROWS : 0;
+    end = MIN (last + OVERSCAN_ROWS, n_items);
+
+    wb_timeline_list_move_window (self, start, first, last, end);
+    wb_timeline_list_update_spacers (self);
+
+    /* No rows were missing for the new posts. */
+    if (priv->loading && priv->tick_id == 0)
+    {
+        priv->loading = FALSE;
+        g_signal_emit (self, signals[LOADED], 0);
+    }
+
+    if (priv->window_start == 0)
+    {
+        wb_timeline_list_refetch (self);
+    }
+
+    wb_timeline_list_evict (self);
+
+    wb_timeline_list_prefetch (self, gtk_adjustment_get_upper (adjustment) - bottom,
+                               gtk_adjustment_get_page_size (adjustment));
+}
+
+static gboolean
+update_window_idle_cb (gpointer user_data)
+{
+    WbTimelineList *self = WB_TIMELINE_LIST (user_data);
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    priv->update_id = 0;
+
+    wb_timeline_list_update_window (self);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Rows can't be added or removed while the list is being allocated. */
+static void
+wb_timeline_list_queue_update (WbTimelineList *self)
+{
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    /* Disposed already. */
+    if (priv->items == NULL)
+    {
+        return;
+    }
+
+    if (priv->update_id == 0)
+    {
+        priv->update_id = g_idle_add (update_window_idle_cb, self);
+    }
+}
+
+static void
+items_changed_cb (GListModel *model,
+                  guint position,
+                  guint removed,
+                  guint added,
+                  gpointer user_data)
+{
+    guint i;
+    WbTimelineList *self = WB_TIMELINE_LIST (user_data);
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    if (position + removed <= priv->window_start)
+    {
+        priv->window_start = priv->window_start - removed + added;
+        priv->window_end = priv->window_end - removed + added;
+    }
+    else if (position < priv->window_end)
+    {
+        /* Rows of the window changed, build it again. */
+        wb_timeline_list_measure_rows (self);
+        wb_timeline_list_clear_window (self);
+    }
+
+    /* Grow the window again once it was moved to the new posts. */
+    priv->target_start = priv->window_start;
+    priv->target_end = priv->window_end;
+    priv->visible_end = priv->window_end;
+
+    for (i = position; i < position + removed; i++)
+    {
+        gint height;
+
+        height = g_array_index (priv->heights, gint, i);
+        if (height >= 0)
+        {
+            priv->known_heights -= height;
+            priv->n_known_heights--;
+        }
+    }
+    g_array_remove_range (priv->heights, position, removed);
+
+    for (i = 0; i < added; i++)
+    {
+        gint height = -1;
+
+        g_array_insert_val (priv->heights, position + i, height);
+    }
+
+    wb_timeline_list_queue_update (self);
+}
+
+static void
+statuses_home_timeline_finished_cb (GObject *source_object,
+                                    GAsyncResult *result,
+                                    gpointer user_data)
+{
+    g_autofree gchar *max_id = NULL;
+    GError *error = NULL;
+    GPtrArray *items;
+    WbTimelineList *self;
+    WbTimelineListPrivate *priv;
+
+    items = wb_api_client_get_home_timeline_finish (WB_API_CLIENT (source_object),
+                                                    result, &error);
+    if (items == NULL)
+    {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_error_free (error);
+            return;
+        }
+
+        g_warning ("%s", error->message);
+        g_error_free (error);
+
+        self = WB_TIMELINE_LIST (user_data);
+        priv = wb_timeline_list_get_instance_private (self);
+        priv->fetching_page = FALSE;
+        g_clear_pointer (&priv->fetching_max_id, g_free);
+
+        return;
+    }
+
+    self = WB_TIMELINE_LIST (user_data);
+    priv = wb_timeline_list_get_instance_private (self);
+
+    priv->fetching_page = FALSE;
+    max_id = g_steal_pointer (&priv->fetching_max_id);
+
+    if (max_id == NULL)
+    {
+        wb_timeline_list_append_page (self, items);
+    }
+    else if (g_strcmp0 (max_id, priv->last_idstr) == 0)
+    {
+        /* Keep it until the end of the timeline is about to be shown. */
+        priv->next_page = g_ptr_array_ref (items);
+        wb_timeline_list_queue_update (self);
+    }
+    /* Otherwise posts at the end were dropped in the meantime, and the
+     * page doesn't follow the timeline anymore. */
+
+    g_ptr_array_unref (items);
+}
+
+/* Small pages get the first screen up fastest, later pages are sized
+ * to last a while at the current scrolling speed. */
+static gint
+wb_timeline_list_get_page_size (WbTimelineList *self)
+{
+    gint row_height;
+    guint min_size;
+    guint max_size;
+    gdouble n_posts;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    min_size = priv->min_page_size;
+    max_size = MAX (priv->min_page_size, priv->max_page_size);
+
+    if (priv->batch_fetched == 0)
+    {
+        return min_size;
+    }
+
+    row_height = priv->n_known_heights != 0
+                 ? priv->known_heights / priv->n_known_heights
+                 : ESTIMATED_ROW_HEIGHT;
+    n_posts = priv->velocity * priv->page_duration / MAX (row_height, 1);
+
+    /* The first post of the page is the last one of the timeline. */
+    return MIN (CLAMP ((guint) n_posts, min_size, max_size) + 1, 100);
+}
+
+static void
+statuses_restored_cb (GObject *source_object,
+                      GAsyncResult *result,
+                      gpointer user_data)
+{
+    GError *error = NULL;
+    GPtrArray *items;
+    WbTimelineList *self;
+    WbTimelineListPrivate *priv;
+
+    items = wb_store_load_home_timeline_finish (WB_STORE (source_object),
+                                                result, &error);
+    if (items == NULL)
+    {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_error_free (error);
+            return;
+        }
+
+        g_warning ("%s", error->message);
+        g_error_free (error);
+    }
+
+    self = WB_TIMELINE_LIST (user_data);
+    priv = wb_timeline_list_get_instance_private (self);
+
+    priv->fetching_page = FALSE;
+
+    if (items == NULL || items->len == 0)
+    {
+        wb_timeline_list_get_home_timeline (self, FALSE);
+    }
+    else
+    {
+        /* Show the timeline as it was last time right away, then fetch
+         * what was posted since. */
+        wb_timeline_list_append_page (self, items);
+        wb_timeline_list_refresh (self);
+    }
+
+    if (items != NULL)
+    {
+        g_ptr_array_unref (items);
+    }
+}
 
-typedef struct
+void
+wb_timeline_list_get_home_timeline (WbTimelineList *self,
+                                    gboolean loading_more)
 {
-    gint batch_fetched;
-    gint64 last_id;
-    gchar *last_idstr;
-    GtkListBox *timeline_list;
-    GtkWidget *timeline_scrolled;
-    WbTweetItem *tweet_item;
-    WbTweetItem *retweeted_item;
-} WbTimelineListPrivate;
+    WbApiClient *client;
+    WbTimelineListPrivate *priv;
 
-G_DEFINE_TYPE_WITH_PRIVATE (WbTimelineList, wb_timeline_list, GTK_TYPE_BOX)
+    priv = wb_timeline_list_get_instance_private (self);
 
-static guint signals[LAST_SIGNAL] = { 0 };
+    /* The page is on its way already. */
+    if (priv->fetching_page)
+    {
+        return;
+    }
 
-WbTweetItem *
-wb_timeline_list_get_tweet_item (WbTimelineList *self)
-{
-    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+    if (loading_more && priv->next_page != NULL)
+    {
+        wb_timeline_list_insert_next_page (self);
+        return;
+    }
 
-    g_return_val_if_fail (WB_TIMELINE_LIST (self), NULL);
+    /* The first page comes from disk if there is one, from the
+     * snapshot if possible as it needs neither parsing nor decoding. */
+    if (!loading_more && priv->batch_fetched == 0 && !priv->restored)
+    {
+        GPtrArray *items;
+        WbStore *store;
 
-    return priv->tweet_item;
+        priv->restored = TRUE;
+
+        items = priv->snapshot_posts != 0 ? wb_snapshot_load () : NULL;
+        if (items != NULL && items->len != 0)
+        {
+            wb_timeline_list_append_page (self, items);
+            wb_timeline_list_refresh (self);
+            g_ptr_array_unref (items);
+            return;
+        }
+        g_clear_pointer (&items, g_ptr_array_unref);
+
+        priv->fetching_page = TRUE;
+
+        store = wb_application_get_store (WB_APPLICATION (g_application_get_default ()));
+        wb_store_load_home_timeline_async (store, priv->max_page_size,
+                                           priv->cancellable,
+                                           statuses_restored_cb, self);
+        return;
+    }
+
+    priv->fetching_page = TRUE;
+    priv->fetching_max_id = loading_more ? g_strdup (priv->last_idstr) : NULL;
+
+    client = wb_application_get_api_client (WB_APPLICATION (g_application_get_default ()));
+    wb_api_client_get_home_timeline_async (client, NULL,
+                                           priv->fetching_max_id,
+                                           wb_timeline_list_get_page_size (self),
+                                           priv->cancellable,
+                                           statuses_home_timeline_finished_cb,
+                                           self);
 }
 
-WbTweetItem *
-wb_timeline_list_get_retweeted_item (WbTimelineList *self)
+/* Id of the newest post of the timeline, dropped from the top or not. */
+static gint64
+wb_timeline_list_get_newest_id (WbTimelineList *self)
 {
+    gint64 id;
+    WbTweetItem *tweet_item;
     WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
 
-    g_return_val_if_fail (WB_TIMELINE_LIST (self), NULL);
+    if (priv->evicted->len != 0)
+    {
+        return g_array_index (priv->evicted, WbEvictedPost, 0).id;
+    }
 
-    return priv->retweeted_item;
+    tweet_item = g_list_model_get_item (G_LIST_MODEL (priv->items), 0);
+    if (tweet_item == NULL)
+    {
+        return 0;
+    }
+
+    id = tweet_item->id;
+    g_object_unref (tweet_item);
+
+    return id;
 }
 
-GtkListBox *
-wb_timeline_list_get_listbox (WbTimelineList *self)
+static gint
+compare_newer_first (gconstpointer a,
+                     gconstpointer b)
 {
-    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+    WbTweetItem *item_a = *(WbTweetItem **) a;
+    WbTweetItem *item_b = *(WbTweetItem **) b;
 
-    g_return_val_if_fail (WB_TIMELINE_LIST (self), NULL);
-
-    return priv->timeline_list;
+    return item_a->id < item_b->id ? 1 : item_a->id > item_b->id ? -1 : 0;
 }
 
+/* Put the posts newer than the timeline on top of it, without moving
+ * the posts in the viewport. */
 static void
-parse_weibo_post (JsonArray *array,
-                  guint index,
-                  JsonNode *element_node,
-                  gpointer user_data)
+wb_timeline_list_merge_newer (WbTimelineList *self,
+                              GPtrArray *items)
 {
-    JsonObject *object;
-    WbTweetItem *tweet_item;
-    WbTweetRow *row;
-    WbTimelineList *self;
-    WbTimelineListPrivate *priv;
+    gint height;
+    gint64 newest_id;
+    guint i;
+    guint n_newer;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
 
-    self = WB_TIMELINE_LIST (user_data);
-    priv = wb_timeline_list_get_instance_private (self);
+    wb_timeline_list_drop_duplicates (self, items);
+    g_ptr_array_sort (items, compare_newer_first);
+
+    newest_id = wb_timeline_list_get_newest_id (self);
+    for (n_newer = 0; n_newer < items->len; n_newer++)
+    {
+        WbTweetItem *tweet_item = g_ptr_array_index (items, n_newer);
+
+        if (tweet_item->id <= newest_id)
+        {
+            break;
+        }
+    }
 
-    /* Weibo API returns an extra item which can be found in the
-     * previous batch of posts fetched before. In this case,
-     * ingore the first post item. */
-    if (index == 0 && priv->batch_fetched != 0)
+    if (n_newer == 0)
     {
         return;
     }
 
-    object = json_node_get_object (element_node);
-    tweet_item = wb_tweet_item_new (object);
+    wb_timeline_list_save (self, items->pdata, n_newer);
 
-    if (index == 0 && priv->batch_fetched == 0)
+    /* Posts above the top of the timeline were dropped, the new ones
+     * are fetched again along with them once scrolled up to. */
+    if (priv->evicted->len != 0)
     {
-        priv->last_id = tweet_item->id;
+        WbEvictedPost *posts;
+
+        posts = g_new (WbEvictedPost, n_newer);
+        for (i = 0; i < n_newer; i++)
+        {
+            WbTweetItem *tweet_item = g_ptr_array_index (items, i);
+
+            posts[i].id = tweet_item->id;
+            posts[i].height = -1;
+        }
+        g_array_prepend_vals (priv->evicted, posts, n_newer);
+        g_free (posts);
+
+        return;
     }
-    if (tweet_item->id < priv->last_id)
+
+    wb_timeline_list_splice (self, 0, 0, items->pdata, n_newer);
+
+    height = 0;
+    for (i = 0; i < n_newer; i++)
     {
-        priv->last_id = tweet_item->id;
-        priv->last_idstr = tweet_item->idstr;
+        height += wb_timeline_list_get_row_height (self, i);
     }
+    priv->pending_scroll += height;
+}
 
-    /* Add retweeted item to the row */
-    if (json_object_has_member (object, "retweeted_status"))
-    {
-        GtkWidget *retweeted_widget;
-        JsonObject *retweeted_object;
-        WbTweetItem *retweeted_item;
+/* Start the timeline over with @items, newest first, when the gap
+ * between them and the timeline is too large to be filled. */
+static void
+wb_timeline_list_replace (WbTimelineList *self,
+                          GPtrArray *items)
+{
+    GtkAdjustment *adjustment;
+    WbStore *store;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
 
-        retweeted_object = json_object_get_object_member (object, "retweeted_status");
-        retweeted_item = wb_tweet_item_new (retweeted_object);
-        /* TODO: Add WbRetweetedItem class? */
-        retweeted_widget = GTK_WIDGET (wb_tweet_row_new (retweeted_item,
-                                                         NULL, TRUE));
+    /* Pages on their way follow the old timeline, they are dropped
+     * once they arrive. */
+    g_array_set_size (priv->evicted, 0);
+    g_clear_pointer (&priv->next_page, g_ptr_array_unref);
+    g_clear_pointer (&priv->last_idstr, g_free);
+    priv->last_id = 0;
 
-        row = wb_tweet_row_new (tweet_item, retweeted_item, FALSE);
-        gtk_list_box_insert (GTK_LIST_BOX (priv->timeline_list),
-                             GTK_WIDGET (row), -1);
+    wb_timeline_list_splice (self, 0,
+                             g_list_model_get_n_items (G_LIST_MODEL (priv->items)),
+                             NULL, 0);
 
-        wb_tweet_row_insert_retweeted_item (row, retweeted_widget);
+    priv->pending_scroll = 0;
+    adjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (priv->timeline_scrolled));
+    gtk_adjustment_set_value (adjustment, gtk_adjustment_get_lower (adjustment));
 
-        g_object_unref (retweeted_item);
-    }
-    else
-    {
-        row = wb_tweet_row_new (tweet_item, NULL, FALSE);
-        gtk_list_box_insert (GTK_LIST_BOX (priv->timeline_list),
-                             GTK_WIDGET (row), -1);
-    }
+    /* Recorded here, the posts on disk don't follow them either. */
+    store = wb_application_get_store (WB_APPLICATION (g_application_get_default ()));
+    wb_store_replace_home_timeline (store, (WbTweetItem **) items->pdata,
+                                    items->len);
 
-    g_object_unref (tweet_item);
+    wb_timeline_list_append_page (self, items);
 }
 
+static void wb_timeline_list_fetch_newer (WbTimelineList *self,
+                                          const gchar *max_id);
+
 static void
-statuses_home_timeline_finished_cb (RestProxyCall *call,
-                                    const GError *error,
-                                    GObject *weak_object,
-                                    gpointer user_data)
+statuses_refreshed_cb (GObject *source_object,
+                       GAsyncResult *result,
+                       gpointer user_data)
 {
-    const gchar *payload;
-    goffset payload_length;
-    GError *err = NULL;
-    JsonNode *root_node;
-    JsonParser *parser;
+    gint64 newest_id;
+    gint64 oldest_id;
+    guint i;
+    guint n_added;
+    gboolean gap_closed;
+    GError *error = NULL;
+    GPtrArray *items;
     WbTimelineList *self;
     WbTimelineListPrivate *priv;
 
-    self = WB_TIMELINE_LIST (user_data);
-    priv = wb_timeline_list_get_instance_private (self);
-
-    if (error != NULL)
+    items = wb_api_client_get_home_timeline_finish (WB_API_CLIENT (source_object),
+                                                    result, &error);
+    if (items == NULL)
     {
-        g_error ("Error calling Weibo API(2/statuses/home_timeline): %s",
-                 error->message);
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_error_free (error);
+            return;
+        }
+
+        g_warning ("%s", error->message);
+        g_error_free (error);
+
+        self = WB_TIMELINE_LIST (user_data);
+        priv = wb_timeline_list_get_instance_private (self);
+
+        /* Showing the pages fetched so far would leave a gap below
+         * them which nothing fills. Keep since_id, the next refresh
+         * fetches the whole gap again. */
+        g_clear_pointer (&priv->refresh_items, g_ptr_array_unref);
+        priv->refreshing = FALSE;
+
         return;
     }
 
-    payload = rest_proxy_call_get_payload (call);
-    payload_length = rest_proxy_call_get_payload_length (call);
+    self = WB_TIMELINE_LIST (user_data);
+    priv = wb_timeline_list_get_instance_private (self);
 
-    parser = json_parser_new ();
-    if (!json_parser_load_from_data (parser, payload, payload_length, &err))
+    /* Weibo API often returns less than asked for, a short page
+     * doesn't mean the timeline is reached. since_id is right below
+     * the newest post of the timeline, the page reaching it has it. */
+    gap_closed = FALSE;
+    newest_id = g_ascii_strtoll (priv->refresh_since_id, NULL, 10) + 1;
+
+    oldest_id = G_MAXINT64;
+    if (priv->refresh_items->len != 0)
     {
-        g_warning ("json_parser_load_from_data () failed: %s (%s, %d)",
-                   err->message,
-                   g_quark_to_string (err->domain),
-                   err->code);
-        g_error_free (err);
+        WbTweetItem *tweet_item;
+
+        tweet_item = g_ptr_array_index (priv->refresh_items,
+                                        priv->refresh_items->len - 1);
+        oldest_id = tweet_item->id;
     }
 
-    root_node = json_parser_get_root (parser);
-    if (JSON_NODE_HOLDS_OBJECT (root_node))
+    n_added = 0;
+    for (i = 0; i < items->len; i++)
     {
-        JsonObject *object;
+        WbTweetItem *tweet_item = g_ptr_array_index (items, i);
 
-        object = json_node_get_object (root_node);
+        /* max_id is part of the page, it was fetched already. */
+        if (tweet_item->id < oldest_id)
+        {
+            g_ptr_array_add (priv->refresh_items, g_object_ref (tweet_item));
+            n_added++;
+        }
 
-        if (json_object_has_member (object, "statuses"))
+        /* It is dropped as a duplicate once merged. */
+        if (tweet_item->id <= newest_id)
         {
-            JsonArray *array;
+            gap_closed = TRUE;
+        }
+    }
 
-            array = json_object_get_array_member (object, "statuses");
-            json_array_foreach_element (array, parse_weibo_post, self);
+    /* The newest post may be gone, nothing is left past it. */
+    if (n_added == 0)
+    {
+        gap_closed = TRUE;
+    }
 
-            priv->batch_fetched++;
-        }
+    if (gap_closed)
+    {
+        wb_timeline_list_merge_newer (self, priv->refresh_items);
+        g_clear_pointer (&priv->refresh_items, g_ptr_array_unref);
+        g_clear_pointer (&priv->refresh_since_id, g_free);
+        priv->refreshing = FALSE;
+        wb_timeline_list_queue_update (self);
+    }
+    else if (priv->max_resident_posts != 0 &&
+             priv->refresh_items->len >= priv->max_resident_posts)
+    {
+        /* The timeline couldn't keep the rest of the gap anyway, start
+         * it over from the pages fetched. */
+        wb_timeline_list_replace (self, priv->refresh_items);
+        g_clear_pointer (&priv->refresh_items, g_ptr_array_unref);
+        g_clear_pointer (&priv->refresh_since_id, g_free);
+        priv->refreshing = FALSE;
+        wb_timeline_list_queue_update (self);
+    }
+    else
+    {
+        g_autofree gchar *max_id = NULL;
+        WbTweetItem *tweet_item;
+
+        tweet_item = g_ptr_array_index (priv->refresh_items,
+                                        priv->refresh_items->len - 1);
+        max_id = wb_tweet_item_dup_idstr (tweet_item);
+        wb_timeline_list_fetch_newer (self, max_id);
     }
 
-    g_signal_emit (self, signals[LOADED], 0);
+    g_ptr_array_unref (items);
+}
+
+static void
+wb_timeline_list_fetch_newer (WbTimelineList *self,
+                              const gchar *max_id)
+{
+    WbApiClient *client;
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
 
-    g_object_unref (parser);
+    client = wb_application_get_api_client (WB_APPLICATION (g_application_get_default ()));
+    wb_api_client_get_home_timeline_async (client, priv->refresh_since_id,
+                                           max_id, priv->max_page_size,
+                                           priv->cancellable,
+                                           statuses_refreshed_cb, self);
 }
 
+/**
+ * wb_timeline_list_refresh:
+ * @list: a #WbTimelineList
+ *
+ * Fetch the posts newer than the timeline and add them on top of it.
+ * Weibo API returns the newest posts first, so pages are fetched until
+ * they reach the timeline.
+ */
 void
-wb_timeline_list_get_home_timeline (WbTimelineList *self,
-                                    gboolean loading_more)
+wb_timeline_list_refresh (WbTimelineList *self)
 {
-    g_autofree gchar *access_token = NULL;
-    g_autofree gchar *app_key = NULL;
-    GError *error = NULL;
-    RestProxy *proxy;
-    RestProxyCall *call;
+    gint64 newest_id;
     WbTimelineListPrivate *priv;
 
+    g_return_if_fail (WB_IS_TIMELINE_LIST (self));
+
     priv = wb_timeline_list_get_instance_private (self);
 
-    access_token = wb_util_get_access_token ();
-    app_key = wb_util_get_app_key ();
+    if (priv->refreshing)
+    {
+        return;
+    }
 
-    proxy = oauth2_proxy_new_with_token (app_key, access_token,
-                                         "https://api.weibo.com/oauth2/authorize",
-                                         "https://api.weibo.com", FALSE);
-    call = rest_proxy_new_call (proxy);
-    rest_proxy_call_set_function (call, "2/statuses/home_timeline.json");
-    rest_proxy_call_set_method (call, "GET");
-    rest_proxy_call_add_param (call, "access_token", access_token);
-    if (loading_more)
+    /* Nothing to be newer than yet. */
+    if (priv->batch_fetched == 0)
     {
-        rest_proxy_call_add_param (call, "max_id", priv->last_idstr);
+        wb_timeline_list_get_home_timeline (self, FALSE);
+        return;
     }
 
-    if (!rest_proxy_call_async (call, statuses_home_timeline_finished_cb,
-                                NULL, self, &error))
+    priv->refreshing = TRUE;
+
+    /* Left over from a refresh which failed, the gap is the same. */
+    if (priv->refresh_since_id == NULL)
     {
-        g_error ("API(2/statues/home_timeline) call cancelled: %s",
-                 error->message);
-        g_error_free (error);
+        /* since_id is left out of the result, the newest post comes
+         * along to tell that the gap is closed. */
+        newest_id = wb_timeline_list_get_newest_id (self);
+        priv->refresh_since_id = g_strdup_printf ("%" G_GINT64_FORMAT,
+                                                  newest_id - 1);
     }
+    priv->refresh_items = g_ptr_array_new_with_free_func (g_object_unref);
 
-    g_object_unref (call);
-    g_object_unref (proxy);
+    wb_timeline_list_fetch_newer (self, NULL);
 }
 
 static void
@@ -257,8 +1474,10 @@ listbox_update_header_func (GtkListBoxRow *row,
                             gpointer user_data)
 {
     GtkWidget *header;
+    WbTimelineList *self = WB_TIMELINE_LIST (user_data);
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
 
-    if (before == NULL)
+    if (priv->window_start + gtk_list_box_row_get_index (row) == 0)
     {
         gtk_list_box_row_set_header (row, NULL);
         return;
@@ -285,8 +1504,11 @@ row_activated_cb (GtkListBox *box,
     list = WB_TIMELINE_LIST (user_data);
     priv = wb_timeline_list_get_instance_private (list);
 
-    priv->tweet_item = wb_tweet_row_get_tweet_item (WB_TWEET_ROW (row));
-    priv->retweeted_item = wb_tweet_row_get_retweeted_item (WB_TWEET_ROW (row));
+    /* The row goes away once it scrolls out of the window. */
+    g_set_object (&priv->tweet_item,
+                  wb_tweet_row_get_tweet_item (WB_TWEET_ROW (row)));
+    g_set_object (&priv->retweeted_item,
+                  wb_tweet_row_get_retweeted_item (WB_TWEET_ROW (row)));
     toplevel = gtk_widget_get_toplevel (GTK_WIDGET (list));
 
     if (gtk_widget_is_toplevel (toplevel))
@@ -309,6 +1531,27 @@ row_activated_cb (GtkListBox *box,
     }
 }
 
+/**
+ * wb_timeline_list_get_model:
+ * @list: a #WbTimelineList
+ *
+ * Rows are only created for the posts around the viewport, the model
+ * holds all of them.
+ *
+ * Returns: (transfer none): a #GListModel of #WbTweetItem
+ */
+GListModel *
+wb_timeline_list_get_model (WbTimelineList *self)
+{
+    WbTimelineListPrivate *priv;
+
+    g_return_val_if_fail (WB_IS_TIMELINE_LIST (self), NULL);
+
+    priv = wb_timeline_list_get_instance_private (self);
+
+    return G_LIST_MODEL (priv->items);
+}
+
 static void
 wb_timeline_list_edge_reached (GtkScrolledWindow *scrolled_window,
                                GtkPositionType pos,
@@ -324,19 +1567,201 @@ wb_timeline_list_edge_reached (GtkScrolledWindow *scrolled_window,
     }
 }
 
+/* Pulling the top of the timeline down refreshes it. */
+static void
+wb_timeline_list_edge_overshot (GtkScrolledWindow *scrolled_window,
+                                GtkPositionType pos,
+                                gpointer user_data)
+{
+    if (pos == GTK_POS_TOP)
+    {
+        wb_timeline_list_refresh (WB_TIMELINE_LIST (user_data));
+    }
+}
+
+static void
+vadjustment_changed_cb (GtkAdjustment *adjustment,
+                        gpointer user_data)
+{
+    wb_timeline_list_queue_update (WB_TIMELINE_LIST (user_data));
+}
+
+static void
+listbox_size_allocate_cb (GtkWidget *widget,
+                          GdkRectangle *allocation,
+                          gpointer user_data)
+{
+    /* Rows were measured, the window may need to grow. */
+    wb_timeline_list_queue_update (WB_TIMELINE_LIST (user_data));
+}
+
+static void
+settings_changed_cb (GSettings *settings,
+                     const gchar *key,
+                     gpointer user_data)
+{
+    WbTimelineList *self = WB_TIMELINE_LIST (user_data);
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    if (g_strcmp0 (key, MAX_RESIDENT_POSTS) == 0)
+    {
+        priv->max_resident_posts = g_settings_get_uint (settings, key);
+        wb_timeline_list_queue_update (self);
+    }
+    else if (g_strcmp0 (key, PREFETCH_DISTANCE) == 0)
+    {
+        priv->prefetch_distance = g_settings_get_uint (settings, key);
+        wb_timeline_list_queue_update (self);
+    }
+    else if (g_strcmp0 (key, MIN_PAGE_SIZE) == 0)
+    {
+        priv->min_page_size = g_settings_get_uint (settings, key);
+    }
+    else if (g_strcmp0 (key, MAX_PAGE_SIZE) == 0)
+    {
+        priv->max_page_size = g_settings_get_uint (settings, key);
+    }
+    else if (g_strcmp0 (key, PAGE_DURATION) == 0)
+    {
+        priv->page_duration = g_settings_get_double (settings, key);
+    }
+    else if (g_strcmp0 (key, SNAPSHOT_POSTS) == 0)
+    {
+        priv->snapshot_posts = g_settings_get_uint (settings, key);
+    }
+    else if (g_strcmp0 (key, UID) == 0)
+    {
+        /* Logged in as someone else, whose timeline is different. */
+        wb_snapshot_discard ();
+    }
+}
+
+/* Write the top of the timeline to the snapshot, so that it is shown
+ * right away next time. */
+static void
+wb_timeline_list_save_snapshot (WbTimelineList *self)
+{
+    guint i;
+    guint n_items;
+    GPtrArray *items;
+    WbTimelineListPrivate *priv;
+
+    priv = wb_timeline_list_get_instance_private (self);
+
+    n_items = MIN (g_list_model_get_n_items (G_LIST_MODEL (priv->items)),
+                   priv->snapshot_posts);
+    if (n_items == 0)
+    {
+        if (priv->snapshot_posts == 0)
+        {
+            wb_snapshot_discard ();
+        }
+
+        return;
+    }
+
+    /* The top of the timeline is not there, what is left would show
+     * up as the newest posts. */
+    if (priv->evicted->len != 0)
+    {
+        wb_snapshot_discard ();
+        return;
+    }
+
+    items = g_ptr_array_new_full (n_items, g_object_unref);
+    for (i = 0; i < n_items; i++)
+    {
+        g_ptr_array_add (items,
+                         g_list_model_get_item (G_LIST_MODEL (priv->items), i));
+    }
+
+    wb_snapshot_save (items);
+
+    g_ptr_array_unref (items);
+}
+
+static void
+wb_timeline_list_dispose (GObject *object)
+{
+    WbTimelineList *self = WB_TIMELINE_LIST (object);
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    if (priv->cancellable != NULL)
+    {
+        g_cancellable_cancel (priv->cancellable);
+        g_clear_object (&priv->cancellable);
+    }
+
+    if (priv->update_id != 0)
+    {
+        g_source_remove (priv->update_id);
+        priv->update_id = 0;
+    }
+
+    if (priv->tick_id != 0)
+    {
+        gtk_widget_remove_tick_callback (GTK_WIDGET (self), priv->tick_id);
+        priv->tick_id = 0;
+    }
+
+    g_clear_object (&priv->tweet_item);
+    g_clear_object (&priv->retweeted_item);
+    g_clear_object (&priv->settings);
+
+    if (priv->items != NULL)
+    {
+        wb_timeline_list_save_snapshot (self);
+
+        /* Keys point into the posts. */
+        g_hash_table_remove_all (priv->ids);
+        g_signal_handlers_disconnect_by_func (priv->items, items_changed_cb,
+                                              self);
+        g_clear_object (&priv->items);
+    }
+
+    G_OBJECT_CLASS (wb_timeline_list_parent_class)->dispose (object);
+}
+
+static void
+wb_timeline_list_finalize (GObject *object)
+{
+    WbTimelineList *self = WB_TIMELINE_LIST (object);
+    WbTimelineListPrivate *priv = wb_timeline_list_get_instance_private (self);
+
+    g_hash_table_unref (priv->ids);
+    g_array_free (priv->heights, TRUE);
+    g_array_free (priv->evicted, TRUE);
+    g_free (priv->last_idstr);
+    g_free (priv->fetching_max_id);
+    g_clear_pointer (&priv->next_page, g_ptr_array_unref);
+    g_free (priv->refresh_since_id);
+    g_clear_pointer (&priv->refresh_items, g_ptr_array_unref);
+
+    G_OBJECT_CLASS (wb_timeline_list_parent_class)->finalize (object);
+}
+
 static void
 wb_timeline_list_class_init (WbTimelineListClass *klass)
 {
+    GObjectClass *object_class;
     GtkWidgetClass *widget_class;
 
+    object_class = G_OBJECT_CLASS (klass);
     widget_class = GTK_WIDGET_CLASS (klass);
 
+    object_class->dispose = wb_timeline_list_dispose;
+    object_class->finalize = wb_timeline_list_finalize;
+
     gtk_widget_class_set_template_from_resource (widget_class,
                                                  "/com/jonathankang/Weibird/wb-timeline-list.ui");
     gtk_widget_class_bind_template_child_private (widget_class,
                                                   WbTimelineList, timeline_list);
     gtk_widget_class_bind_template_child_private (widget_class,
                                                   WbTimelineList, timeline_scrolled);
+    gtk_widget_class_bind_template_child_private (widget_class,
+                                                  WbTimelineList, top_spacer);
+    gtk_widget_class_bind_template_child_private (widget_class,
+                                                  WbTimelineList, bottom_spacer);
 
     signals[LOADED] = g_signal_new ("loaded",
                                     G_TYPE_FROM_CLASS (klass),
@@ -352,6 +1777,7 @@ wb_timeline_list_class_init (WbTimelineListClass *klass)
 static void
 wb_timeline_list_init (WbTimelineList *self)
 {
+    GtkAdjustment *adjustment;
     WbTimelineListPrivate *priv;
 
     gtk_widget_init_template (GTK_WIDGET (self));
@@ -359,15 +1785,70 @@ wb_timeline_list_init (WbTimelineList *self)
     priv = wb_timeline_list_get_instance_private (self);
 
     priv->batch_fetched = 0;
+    priv->cancellable = g_cancellable_new ();
+    priv->items = g_list_store_new (WB_TYPE_TWEET_ITEM);
+    priv->ids = g_hash_table_new (g_int64_hash, g_int64_equal);
+    priv->heights = g_array_new (FALSE, FALSE, sizeof (gint));
+    priv->known_heights = 0;
+    priv->n_known_heights = 0;
+    priv->window_start = 0;
+    priv->window_end = 0;
+    priv->target_start = 0;
+    priv->target_end = 0;
+    priv->visible_end = 0;
+    priv->tick_id = 0;
+    priv->loading = FALSE;
+    priv->update_id = 0;
+    priv->pending_scroll = 0;
+    priv->evicted = g_array_new (FALSE, FALSE, sizeof (WbEvictedPost));
+    priv->refetching = FALSE;
+    priv->last_idstr = NULL;
+
+    priv->settings = g_settings_new (SETTINGS_SCHEMA);
+    priv->max_resident_posts = g_settings_get_uint (priv->settings,
+                                                    MAX_RESIDENT_POSTS);
+    priv->prefetch_distance = g_settings_get_uint (priv->settings,
+                                                   PREFETCH_DISTANCE);
+    priv->min_page_size = g_settings_get_uint (priv->settings, MIN_PAGE_SIZE);
+    priv->max_page_size = g_settings_get_uint (priv->settings, MAX_PAGE_SIZE);
+    priv->page_duration = g_settings_get_double (priv->settings,
+                                                 PAGE_DURATION);
+    priv->fetching_page = FALSE;
+    priv->fetching_max_id = NULL;
+    priv->next_page = NULL;
+    priv->velocity = 0;
+    priv->last_value = 0;
+    priv->last_value_time = g_get_monotonic_time ();
+    priv->refreshing = FALSE;
+    priv->refresh_since_id = NULL;
+    priv->refresh_items = NULL;
+    priv->restored = FALSE;
+    priv->snapshot_posts = g_settings_get_uint (priv->settings,
+                                                SNAPSHOT_POSTS);
+    g_signal_connect (priv->settings, "changed",
+                      G_CALLBACK (settings_changed_cb), self);
+
+    g_signal_connect (priv->items, "items-changed",
+                      G_CALLBACK (items_changed_cb), self);
 
     gtk_list_box_set_header_func (priv->timeline_list,
                                   (GtkListBoxUpdateHeaderFunc) listbox_update_header_func,
-                                  NULL, NULL);
+                                  self, NULL);
 
     g_signal_connect (priv->timeline_list, "row-activated",
                       G_CALLBACK (row_activated_cb), self);
     g_signal_connect (priv->timeline_scrolled, "edge-reached",
                       G_CALLBACK (wb_timeline_list_edge_reached), self);
+    g_signal_connect (priv->timeline_scrolled, "edge-overshot",
+                      G_CALLBACK (wb_timeline_list_edge_overshot), self);
+    g_signal_connect (priv->timeline_list, "size-allocate",
+                      G_CALLBACK (listbox_size_allocate_cb), self);
+
+    adjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (priv->timeline_scrolled));
+    g_signal_connect (adjustment, "value-changed",
+                      G_CALLBACK (vadjustment_changed_cb), self);
+    g_signal_connect (adjustment, "changed",
+                      G_CALLBACK (vadjustment_changed_cb), self);
 }
 
 /**
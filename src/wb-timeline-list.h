@@ -31,7 +31,9 @@ G_DECLARE_FINAL_TYPE (WbTimelineList, wb_timeline_list, WB, TIMELINE_LIST, GtkBo
 WbTweetItem *wb_timeline_list_get_tweet_item (WbTimelineList *list);
 WbTweetItem *wb_timeline_list_get_retweeted_item (WbTimelineList *list);
 GtkListBox *wb_timeline_list_get_listbox (WbTimelineList *list);
+GListModel *wb_timeline_list_get_model (WbTimelineList *list);
 void wb_timeline_list_get_home_timeline (WbTimelineList *list, gboolean loading_more);
+void wb_timeline_list_refresh (WbTimelineList *list);
 WbTimelineList *wb_timeline_list_new (void);
 
 G_END_DECLS
@@ -19,8 +19,9 @@
 #include <glib.h>
 #include <gtk/gtk.h>
 #include <json-glib/json-glib.h>
-#include <rest/oauth2-proxy.h>
 
+#include "wb-api-client.h"
+#include "wb-application.h"
 #include "wb-avatar-widget.h"
 #include "wb-comment.h"
 #include "wb-comment-list.h"
@@ -62,6 +63,7 @@ typedef struct
     GtkWidget *comments_label;
     GtkWidget *no_comments_label;
     GtkWidget *reposts_label;
+    GCancellable *cancellable;
     WbMultiMediaWidget *mm_widget;
     WbTweetItem *tweet_item;
     WbTweetItem *retweeted_item;
@@ -72,110 +74,68 @@ G_DEFINE_TYPE_WITH_PRIVATE (WbTweetDetailPage, wb_tweet_detail_page, GTK_TYPE_SC
 static GParamSpec *obj_properties[N_PROPERTIES] = { NULL, };
 
 static void
-wb_tweet_detail_page_add_comment (WbTweetDetailPage *self,
-                                  const gchar *comment)
+comments_create_finished_cb (GObject *source_object,
+                             GAsyncResult *result,
+                             gpointer user_data)
 {
-    const gchar *payload;
-    g_autofree gchar *access_token = NULL;
-    g_autofree gchar *app_key = NULL;
-    gssize payload_length;
     GError *error = NULL;
     JsonNode *root_node;
-    JsonParser *parser;
-    RestProxy *proxy;
-    RestProxyCall *call;
+    WbTweetDetailPage *self;
     WbTweetDetailPagePrivate *priv;
 
-    priv = wb_tweet_detail_page_get_instance_private (self);
-
-    access_token = wb_util_get_access_token ();
-    app_key = wb_util_get_app_key ();
-
-    proxy = oauth2_proxy_new_with_token (app_key, access_token,
-                                         "https://api.weibo.com/oauth2/authorize",
-                                         "https://api.weibo.com", FALSE);
-    call = rest_proxy_new_call (proxy);
-    rest_proxy_call_set_function (call, "2/comments/create.json");
-    rest_proxy_call_set_method (call, "POST");
-    rest_proxy_call_add_param (call, "access_token", access_token);
-    rest_proxy_call_add_param (call, "id", priv->tweet_item->idstr);
-    rest_proxy_call_add_param (call, "comment", comment);
-
-    rest_proxy_call_sync (call, &error);
-    if (error != NULL)
+    root_node = wb_api_client_create_comment_finish (WB_API_CLIENT (source_object),
+                                                     result, &error);
+    if (root_node == NULL)
     {
-        GError *parser_error = NULL;
-
-        payload = rest_proxy_call_get_payload (call);
-        payload_length = rest_proxy_call_get_payload_length (call);
-
-        parser = json_parser_new ();
-        if (!json_parser_load_from_data (parser, payload,
-                                         payload_length, &parser_error))
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
         {
-            g_warning ("Failed to parse comment data: %s (%s, %d)",
-                       parser_error->message,
-                       g_quark_to_string (parser_error->domain),
-                       parser_error->code);
-            g_error_free (parser_error);
+            g_warning ("%s", error->message);
         }
 
-        root_node = json_parser_get_root (parser);
-        if (JSON_NODE_HOLDS_OBJECT (root_node))
-        {
-            JsonObject *object;
+        g_error_free (error);
+        return;
+    }
 
-            object = json_node_get_object (root_node);
+    self = WB_TWEET_DETAIL_PAGE (user_data);
+    priv = wb_tweet_detail_page_get_instance_private (self);
 
-            g_warning ("Failed to send request: %s (%s, %s)",
-                       json_object_get_string_member (object, "request"),
-                       json_object_get_string_member (object, "error_code"),
-                       json_object_get_string_member (object, "error"));
-        }
-        else
-        {
-            g_warning ("Error calling Weibo API(2/comments/create): %s",
-                       error->message);
-            g_error_free (error);
-        }
-    }
-    else
+    if (JSON_NODE_HOLDS_OBJECT (root_node))
     {
-        payload = rest_proxy_call_get_payload (call);
-        payload_length = rest_proxy_call_get_payload_length (call);
+        JsonObject *object;
+        WbComment *comment;
+        WbEntityStore *store;
 
-        parser = json_parser_new ();
-        if (!json_parser_load_from_data (parser, payload,
-                                         payload_length, &error))
-        {
-            g_warning ("Failed to parse comment data: %s (%s, %d)",
-                       error->message,
-                       g_quark_to_string (error->domain),
-                       error->code);
-            g_error_free (error);
-        }
+        object = json_node_get_object (root_node);
 
-        root_node = json_parser_get_root (parser);
-        if (JSON_NODE_HOLDS_OBJECT (root_node))
-        {
-            JsonObject *object;
-            WbComment *comment;
-            WbCommentRow *comment_row;
+        /* Parse the data and insert a comment row */
+        comment = wb_comment_new (object);
+        store = wb_application_get_entity_store (WB_APPLICATION (g_application_get_default ()));
+        wb_entity_store_intern_comment (store, comment);
 
-            object = json_node_get_object (root_node);
+        wb_comment_list_insert_comment (WB_COMMENT_LIST (priv->listbox),
+                                        comment);
 
-            /* Parse the data and insert a comment row */
-            comment = wb_comment_new (object);
-            comment_row = wb_comment_row_new (comment);
+        g_object_unref (comment);
+    }
 
-            wb_comment_list_insert_comment_widget (WB_COMMENT_LIST (priv->listbox),
-                                                   comment_row);
+    json_node_unref (root_node);
+}
 
-            g_object_unref (comment);
-        }
-    }
+static void
+wb_tweet_detail_page_add_comment (WbTweetDetailPage *self,
+                                  const gchar *comment)
+{
+    g_autofree gchar *idstr = NULL;
+    WbApiClient *client;
+    WbTweetDetailPagePrivate *priv;
+
+    priv = wb_tweet_detail_page_get_instance_private (self);
 
-    g_object_unref (parser);
+    idstr = wb_tweet_item_dup_idstr (priv->tweet_item);
+    client = wb_application_get_api_client (WB_APPLICATION (g_application_get_default ()));
+    wb_api_client_create_comment_async (client, idstr,
+                                        comment, priv->cancellable,
+                                        comments_create_finished_cb, self);
 }
 
 static void
@@ -256,11 +216,59 @@ no_comments_cb (WbCommentList *listbox,
                                  priv->no_comments_label);
 }
 
+/* Older comments are shown at the end of the page. */
 static void
-wb_tweet_detail_page_constructed (GObject *object)
+wb_tweet_detail_page_edge_reached (GtkScrolledWindow *scrolled_window,
+                                   GtkPositionType pos,
+                                   gpointer user_data)
+{
+    WbTweetDetailPage *self;
+    WbTweetDetailPagePrivate *priv;
+
+    self = WB_TWEET_DETAIL_PAGE (scrolled_window);
+    priv = wb_tweet_detail_page_get_instance_private (self);
+
+    if (pos == GTK_POS_BOTTOM)
+    {
+        wb_comment_list_load_more (WB_COMMENT_LIST (priv->listbox));
+    }
+}
+
+static void
+wb_tweet_detail_page_update_counts (WbTweetDetailPage *self)
 {
-    gchar *created_at;
     gchar *markup;
+    WbTweetDetailPagePrivate *priv = wb_tweet_detail_page_get_instance_private (self);
+
+    markup = g_markup_printf_escaped ("<b>%d</b> Likes",
+                                      priv->tweet_item->attitudes_count);
+    gtk_label_set_markup (GTK_LABEL (priv->likes_label), markup);
+    g_free (markup);
+
+    markup = g_markup_printf_escaped ("<b>%d</b> Comments",
+                                      priv->tweet_item->comments_count);
+    gtk_label_set_markup (GTK_LABEL (priv->comments_label), markup);
+    g_free (markup);
+
+    markup = g_markup_printf_escaped ("<b>%d</b> Reposts",
+                                      priv->tweet_item->reposts_count);
+    gtk_label_set_markup (GTK_LABEL (priv->reposts_label), markup);
+    g_free (markup);
+}
+
+/* The post was fetched again with newer counts. */
+static void
+tweet_item_counts_changed_cb (GObject *object,
+                              GParamSpec *pspec,
+                              gpointer user_data)
+{
+    wb_tweet_detail_page_update_counts (WB_TWEET_DETAIL_PAGE (user_data));
+}
+
+static void
+wb_tweet_detail_page_constructed (GObject *object)
+{
+    gchar *idstr;
     WbTweetDetailPage *self;
     WbTweetDetailPagePrivate *priv;
 
@@ -268,57 +276,41 @@ wb_tweet_detail_page_constructed (GObject *object)
     priv = wb_tweet_detail_page_get_instance_private (self);
 
     wb_avatar_widget_setup (WB_AVATAR_WIDGET (priv->avatar_widget),
-                            priv->tweet_item->user->profile_image_url);
+                            priv->tweet_item->user);
 
-    if (g_strcmp0 (priv->tweet_item->user->nickname, "") != 0)
-    {
-        wb_name_button_set_text (WB_NAME_BUTTON (priv->name_button),
-                                 priv->tweet_item->user->nickname);
-    }
-    else
-    {
-        wb_name_button_set_text (WB_NAME_BUTTON (priv->name_button),
-                                 priv->tweet_item->user->name);
-    }
+    wb_name_button_set_user (WB_NAME_BUTTON (priv->name_button),
+                             priv->tweet_item->user);
 
     if (g_strcmp0 (priv->tweet_item->source, "") != 0)
     {
-        gchar *source;
-
-        source = wb_util_format_source_string (priv->tweet_item->source);
-        gtk_label_set_text (GTK_LABEL (priv->source_label), source);
-
-        g_free (source);
+        gtk_label_set_text (GTK_LABEL (priv->source_label),
+                            priv->tweet_item->source);
     }
 
-    created_at = wb_util_format_time_string (priv->tweet_item->created_at);
-    gtk_label_set_text (GTK_LABEL (priv->time_label), created_at);
+    wb_util_set_time_label (GTK_LABEL (priv->time_label),
+                            priv->tweet_item->created_at);
 
     gtk_label_set_text (GTK_LABEL (priv->content_label), priv->tweet_item->text);
 
     /* Post image(s) */
-    if (priv->tweet_item->picuri_array->len != 0)
+    if (priv->tweet_item->n_pictures != 0)
     {
         wb_multi_media_widget_populate_images (priv->mm_widget,
-                                               priv->tweet_item->picuri_array);
+                                               priv->tweet_item);
         gtk_widget_show_all (GTK_WIDGET (priv->mm_widget));
     }
 
     /* Likes, comments and reposts buttons. */
-    markup = g_markup_printf_escaped ("<b>%d</b> Likes",
-                                      priv->tweet_item->attitudes_count);
-    gtk_label_set_markup (GTK_LABEL (priv->likes_label), markup);
-    g_free (markup);
-
-    markup = g_markup_printf_escaped ("<b>%d</b> Comments",
-                                      priv->tweet_item->comments_count);
-    gtk_label_set_markup (GTK_LABEL (priv->comments_label), markup);
-    g_free (markup);
-
-    markup = g_markup_printf_escaped ("<b>%d</b> Reposts",
-                                      priv->tweet_item->reposts_count);
-    gtk_label_set_markup (GTK_LABEL (priv->reposts_label), markup);
-    g_free (markup);
+    wb_tweet_detail_page_update_counts (self);
+    g_signal_connect_object (priv->tweet_item, "notify::attitudes-count",
+                             G_CALLBACK (tweet_item_counts_changed_cb),
+                             self, 0);
+    g_signal_connect_object (priv->tweet_item, "notify::comments-count",
+                             G_CALLBACK (tweet_item_counts_changed_cb),
+                             self, 0);
+    g_signal_connect_object (priv->tweet_item, "notify::reposts-count",
+                             G_CALLBACK (tweet_item_counts_changed_cb),
+                             self, 0);
 
     /* Retweeted content */
     if (priv->retweeted_item != NULL)
@@ -334,18 +326,36 @@ wb_tweet_detail_page_constructed (GObject *object)
         gtk_widget_set_no_show_all (priv->retweet_box, TRUE);
     }
 
-    wb_comment_list_load_comments (WB_COMMENT_LIST (priv->listbox),
-                                   priv->tweet_item->idstr);
+    idstr = wb_tweet_item_dup_idstr (priv->tweet_item);
+    wb_comment_list_load_comments (WB_COMMENT_LIST (priv->listbox), idstr);
     /* Pass tweet id down to WbCommentList */
-    wb_comment_list_set_tweet_id (WB_COMMENT_LIST (priv->listbox),
-                                  priv->tweet_item->idstr);
+    wb_comment_list_set_tweet_id (WB_COMMENT_LIST (priv->listbox), idstr);
 
     gtk_widget_show_all (GTK_WIDGET (self));
 
-    g_free (created_at);
+    g_free (idstr);
 
     G_OBJECT_CLASS (wb_tweet_detail_page_parent_class)->constructed (object);
 }
+
+static void
+wb_tweet_detail_page_dispose (GObject *object)
+{
+    WbTweetDetailPage *self;
+    WbTweetDetailPagePrivate *priv;
+
+    self = WB_TWEET_DETAIL_PAGE (object);
+    priv = wb_tweet_detail_page_get_instance_private (self);
+
+    if (priv->cancellable != NULL)
+    {
+        g_cancellable_cancel (priv->cancellable);
+        g_clear_object (&priv->cancellable);
+    }
+
+    G_OBJECT_CLASS (wb_tweet_detail_page_parent_class)->dispose (object);
+}
+
 static void
 wb_tweet_detail_page_finalize (GObject *object)
 {
@@ -416,6 +426,7 @@ wb_tweet_detail_page_class_init (WbTweetDetailPageClass *klass)
     GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
     gobject_class->constructed = wb_tweet_detail_page_constructed;
+    gobject_class->dispose = wb_tweet_detail_page_dispose;
     gobject_class->finalize = wb_tweet_detail_page_finalize;
     gobject_class->get_property = wb_tweet_detail_page_get_property;
     gobject_class->set_property = wb_tweet_detail_page_set_property;
@@ -495,6 +506,8 @@ wb_tweet_detail_page_init (WbTweetDetailPage *self)
 
     gtk_widget_init_template (GTK_WIDGET (self));
 
+    priv->cancellable = g_cancellable_new ();
+
     clist = wb_comment_list_new ();
     g_signal_connect (clist, "loaded", G_CALLBACK (comments_loaded_cb), self);
     g_signal_connect (clist, "no-comments", G_CALLBACK (no_comments_cb), self);
@@ -502,6 +515,9 @@ wb_tweet_detail_page_init (WbTweetDetailPage *self)
     priv->listbox = GTK_WIDGET (clist);
     gtk_stack_add_named (GTK_STACK (priv->comments_section),
                          priv->listbox, "comments");
+
+    g_signal_connect (self, "edge-reached",
+                      G_CALLBACK (wb_tweet_detail_page_edge_reached), NULL);
 }
 
 WbTweetDetailPage *
@@ -17,87 +17,233 @@
  */
 
 #include <json-glib/json-glib.h>
+#include <string.h>
 
 #include "wb-tweet-item.h"
 #include "wb-user.h"
 #include "wb-util.h"
 
+enum
+{
+    PROP_0,
+    PROP_REPOSTS_COUNT,
+    PROP_COMMENTS_COUNT,
+    PROP_ATTITUDES_COUNT,
+    N_PROPERTIES
+};
+
 G_DEFINE_TYPE (WbTweetItem, wb_tweet_item, G_TYPE_OBJECT)
 
+static GParamSpec *obj_properties[N_PROPERTIES] = { NULL, };
+
+/* The text of the <a> tag Weibo API describes the client with. There
+ * are only so many clients, each name is kept once for all the posts. */
+static const gchar *
+intern_source (const gchar *source)
+{
+    gchar buffer[256];
+    const gchar *start;
+    const gchar *end;
+    gsize length;
+
+    if (source == NULL)
+    {
+        return NULL;
+    }
+
+    start = strchr (source, '>');
+    if (start == NULL)
+    {
+        return g_intern_string (source);
+    }
+    start++;
+
+    end = strchr (start, '<');
+    length = end != NULL ? (gsize) (end - start) : strlen (start);
+    if (length >= sizeof (buffer))
+    {
+        gchar *name;
+        const gchar *interned;
+
+        name = g_strndup (start, length);
+        interned = g_intern_string (name);
+        g_free (name);
+
+        return interned;
+    }
+
+    memcpy (buffer, start, length);
+    buffer[length] = '\0';
+
+    return g_intern_string (buffer);
+}
+
+/* Thumbnails are at <host>/thumbnail/<file name>, the other sizes of
+ * the picture only differ by the directory. */
 static void
-parse_pic_uri (JsonArray *array,
-               guint index,
-               JsonNode *element_node,
-               gpointer user_data)
+wb_tweet_item_parse_pictures (WbTweetItem *self,
+                              JsonArray *array)
 {
-    const gchar *thumbnail;
-    gchar *uri;
-    JsonObject *object;
-    WbTweetItem *self = WB_TWEET_ITEM (user_data);
+    gchar host[128];
+    guint i;
+    guint length;
+    GString *ids;
 
-    object = json_node_get_object (element_node);
+    length = json_array_get_length (array);
+    if (length == 0)
+    {
+        return;
+    }
 
-    thumbnail = json_object_get_string_member (object, "thumbnail_pic");
-    uri = g_strdup (thumbnail);
-    g_array_append_val (self->picuri_array, uri);
+    ids = g_string_sized_new (length * 40);
+
+    for (i = 0; i < length; i++)
+    {
+        const gchar *thumbnail;
+        const gchar *directory;
+        JsonObject *object;
+
+        object = json_array_get_object_element (array, i);
+        thumbnail = json_object_get_string_member (object, "thumbnail_pic");
+        if (thumbnail == NULL)
+        {
+            continue;
+        }
+
+        directory = g_strrstr (thumbnail, "/thumbnail/");
+        if (directory == NULL ||
+            (gsize) (directory - thumbnail) >= sizeof (host))
+        {
+            g_warning ("Unexpected picture uri: %s", thumbnail);
+            continue;
+        }
+
+        if (self->pic_host == NULL)
+        {
+            memcpy (host, thumbnail, directory - thumbnail);
+            host[directory - thumbnail] = '\0';
+            self->pic_host = g_intern_string (host);
+        }
+
+        /* Including the nul byte. */
+        g_string_append_len (ids, directory + strlen ("/thumbnail/"),
+                             strlen (directory + strlen ("/thumbnail/")) + 1);
+        self->n_pictures++;
+    }
+
+    if (self->n_pictures != 0)
+    {
+        self->pic_ids = g_string_free (ids, FALSE);
+    }
+    else
+    {
+        g_string_free (ids, TRUE);
+    }
 }
 
 static void
 wb_tweet_item_parse_json_object (WbTweetItem *self,
                                  JsonObject *object)
 {
-    JsonArray *pic_array;
     JsonObject *user_object;
 
-    self->created_at = g_strdup (json_object_get_string_member (object, "created_at"));
+    self->created_at = wb_util_parse_time_string (json_object_get_string_member (object, "created_at"));
     self->id = json_object_get_int_member (object, "id");
     self->mid = json_object_get_int_member (object, "mid");
-    self->idstr = g_strdup (json_object_get_string_member (object, "idstr"));
     self->text = g_strdup (json_object_get_string_member (object, "text"));
-    self->source = g_strdup (json_object_get_string_member (object, "source"));
+    self->source = intern_source (json_object_get_string_member (object, "source"));
     self->favourited = json_object_get_boolean_member (object, "favorited");
     self->reposts_count = json_object_get_int_member (object, "reposts_count");
     self->comments_count = json_object_get_int_member (object, "comments_count");
     self->attitudes_count = json_object_get_int_member (object, "attitudes_count");
 
-    /* Parse the uri for each picture if there is any */
-    self->picuri_array = g_array_new (FALSE, FALSE, sizeof (gchar *));
-    pic_array = json_object_get_array_member (object, "pic_urls");
-    if (json_array_get_length (pic_array) != 0)
+    if (json_object_has_member (object, "pic_urls"))
     {
-        json_array_foreach_element (pic_array, parse_pic_uri, self);
+        wb_tweet_item_parse_pictures (self,
+                                      json_object_get_array_member (object, "pic_urls"));
     }
 
     user_object = json_object_get_object_member (object, "user");
     self->user = wb_user_new (user_object);
+
+    if (json_object_has_member (object, "retweeted_status"))
+    {
+        JsonObject *retweeted_object;
+
+        retweeted_object = json_object_get_object_member (object,
+                                                          "retweeted_status");
+        self->retweeted_item = wb_tweet_item_new (retweeted_object);
+    }
 }
 
 static void
 wb_tweet_item_finalize (GObject *object)
 {
-    gint i;
     WbTweetItem *self = (WbTweetItem *)object;
 
-    for (i = 0; i < self->picuri_array->len; i++)
-    {
-        g_free (g_array_index (self->picuri_array, gchar *, i));
-    }
-    g_array_free (self->picuri_array, TRUE);
-    g_free (self->created_at);
-    g_free (self->idstr);
+    g_free (self->pic_ids);
     g_free (self->text);
-    g_free (self->source);
     g_object_unref (self->user);
+    g_clear_object (&self->retweeted_item);
+    g_free (self->json);
 
     G_OBJECT_CLASS (wb_tweet_item_parent_class)->finalize (object);
 }
 
+static void
+wb_tweet_item_get_property (GObject *object,
+                            guint prop_id,
+                            GValue *value,
+                            GParamSpec *pspec)
+{
+    WbTweetItem *self = WB_TWEET_ITEM (object);
+
+    switch (prop_id)
+    {
+        case PROP_REPOSTS_COUNT:
+            g_value_set_int (value, self->reposts_count);
+            break;
+        case PROP_COMMENTS_COUNT:
+            g_value_set_int (value, self->comments_count);
+            break;
+        case PROP_ATTITUDES_COUNT:
+            g_value_set_int (value, self->attitudes_count);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+}
+
 static void
 wb_tweet_item_class_init (WbTweetItemClass *klass)
 {
 		GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
 		object_class->finalize = wb_tweet_item_finalize;
+		object_class->get_property = wb_tweet_item_get_property;
+
+    obj_properties[PROP_REPOSTS_COUNT] = g_param_spec_int ("reposts-count",
+                                                           "Reposts count",
+                                                           "Number of reposts of the post",
+                                                           0, G_MAXINT, 0,
+                                                           G_PARAM_READABLE |
+                                                           G_PARAM_STATIC_STRINGS);
+    obj_properties[PROP_COMMENTS_COUNT] = g_param_spec_int ("comments-count",
+                                                            "Comments count",
+                                                            "Number of comments on the post",
+                                                            0, G_MAXINT, 0,
+                                                            G_PARAM_READABLE |
+                                                            G_PARAM_STATIC_STRINGS);
+    obj_properties[PROP_ATTITUDES_COUNT] = g_param_spec_int ("attitudes-count",
+                                                             "Attitudes count",
+                                                             "Number of likes of the post",
+                                                             0, G_MAXINT, 0,
+                                                             G_PARAM_READABLE |
+                                                             G_PARAM_STATIC_STRINGS);
+
+    g_object_class_install_properties (object_class, N_PROPERTIES,
+                                       obj_properties);
 }
 
 static void
@@ -105,6 +251,93 @@ wb_tweet_item_init (WbTweetItem *self)
 {
 }
 
+/**
+ * wb_tweet_item_update_counts:
+ * @self: a #WbTweetItem
+ * @newer: the same post, fetched again
+ *
+ * Take the reposts, comments and likes counts of @newer, notifying
+ * the ones which changed.
+ */
+void
+wb_tweet_item_update_counts (WbTweetItem *self,
+                             WbTweetItem *newer)
+{
+    g_return_if_fail (WB_IS_TWEET_ITEM (self));
+    g_return_if_fail (WB_IS_TWEET_ITEM (newer));
+
+    g_object_freeze_notify (G_OBJECT (self));
+
+    if (self->reposts_count != newer->reposts_count)
+    {
+        self->reposts_count = newer->reposts_count;
+        g_object_notify_by_pspec (G_OBJECT (self),
+                                  obj_properties[PROP_REPOSTS_COUNT]);
+    }
+    if (self->comments_count != newer->comments_count)
+    {
+        self->comments_count = newer->comments_count;
+        g_object_notify_by_pspec (G_OBJECT (self),
+                                  obj_properties[PROP_COMMENTS_COUNT]);
+    }
+    if (self->attitudes_count != newer->attitudes_count)
+    {
+        self->attitudes_count = newer->attitudes_count;
+        g_object_notify_by_pspec (G_OBJECT (self),
+                                  obj_properties[PROP_ATTITUDES_COUNT]);
+    }
+
+    g_object_thaw_notify (G_OBJECT (self));
+}
+
+/**
+ * wb_tweet_item_dup_idstr:
+ * @self: a #WbTweetItem
+ *
+ * Returns: (transfer full): the id of the post as a string, the way
+ * Weibo API takes it
+ */
+gchar *
+wb_tweet_item_dup_idstr (WbTweetItem *self)
+{
+    g_return_val_if_fail (WB_IS_TWEET_ITEM (self), NULL);
+
+    return g_strdup_printf ("%" G_GINT64_FORMAT, self->id);
+}
+
+/**
+ * wb_tweet_item_get_picture_uri:
+ * @self: a #WbTweetItem
+ * @index: index of the picture, less than @self->n_pictures
+ * @size: the size to get the picture in
+ *
+ * Returns: (transfer full): the uri of the picture
+ */
+gchar *
+wb_tweet_item_get_picture_uri (WbTweetItem *self,
+                               guint index,
+                               WbPictureSize size)
+{
+    static const gchar *directories[] = {
+        "thumbnail", /* WB_PICTURE_SIZE_THUMBNAIL */
+        "bmiddle",   /* WB_PICTURE_SIZE_MIDDLE */
+        "large"      /* WB_PICTURE_SIZE_LARGE */
+    };
+    const gchar *id;
+    guint i;
+
+    g_return_val_if_fail (WB_IS_TWEET_ITEM (self), NULL);
+    g_return_val_if_fail (index < self->n_pictures, NULL);
+
+    id = self->pic_ids;
+    for (i = 0; i < index; i++)
+    {
+        id += strlen (id) + 1;
+    }
+
+    return g_strconcat (self->pic_host, "/", directories[size], "/", id, NULL);
+}
+
 /**
  * wb_tweet_item_new:
  *
@@ -25,26 +25,45 @@
 
 G_BEGIN_DECLS
 
+typedef enum
+{
+    WB_PICTURE_SIZE_THUMBNAIL,
+    WB_PICTURE_SIZE_MIDDLE,
+    WB_PICTURE_SIZE_LARGE
+} WbPictureSize;
+
 struct _WbTweetItem
 {
 		GObject parent_instance;
 
-    gchar *created_at;
+    /* Unix time. */
+    gint64 created_at;
     gint64 id;
     gint64 mid;
-    gchar *idstr;
 
     gchar *text;
-    gchar *source;
+    /* Name of the client the post was sent from, interned. */
+    const gchar *source;
 
     gboolean favourited;
-    GArray *picuri_array;
+    /* Server the pictures are on, interned, and the file names of the
+     * pictures one after another, each ending with a nul byte. See
+     * wb_tweet_item_get_picture_uri(). */
+    const gchar *pic_host;
+    gchar *pic_ids;
+    guint n_pictures;
 
     gint reposts_count;
     gint comments_count;
     gint attitudes_count;
 
     WbUser *user;
+    /* The reposted post, or %NULL. */
+    struct _WbTweetItem *retweeted_item;
+
+    /* The data Weibo API returned for the post, until it is recorded
+     * on disk, or %NULL. See wb_store_save_home_timeline(). */
+    gchar *json;
 };
 
 #define WB_TYPE_TWEET_ITEM (wb_tweet_item_get_type ())
@@ -52,7 +71,12 @@ struct _WbTweetItem
 G_DECLARE_FINAL_TYPE (WbTweetItem, wb_tweet_item, WB, TWEET_ITEM, GObject)
 
 gint64 wb_tweet_item_get_id (WbTweetItem *tweet_item);
-const gchar *wb_tweet_item_get_idstr (WbTweetItem *tweet_item);
+gchar *wb_tweet_item_dup_idstr (WbTweetItem *tweet_item);
+gchar *wb_tweet_item_get_picture_uri (WbTweetItem *tweet_item,
+                                      guint index,
+                                      WbPictureSize size);
+void wb_tweet_item_update_counts (WbTweetItem *tweet_item,
+                                  WbTweetItem *newer);
 WbTweetItem *wb_tweet_item_new (JsonObject *jobject);
 
 G_END_DECLS
@@ -47,10 +47,12 @@ typedef struct
 {
     gboolean retweet;
     GtkWidget *comment_button;
+    GtkWidget *likes_label;
+    GtkWidget *comments_label;
+    GtkWidget *reposts_label;
     GtkWidget *main_box;
     GtkWidget *retweet_box;
     GtkWidget *profile_image;
-    GtkWidget *post_image;
     WbTweetItem *tweet_item;
     WbTweetItem *retweeted_item;
 } WbTweetRowPrivate;
@@ -108,10 +110,39 @@ wb_tweet_row_insert_retweeted_item (WbTweetRow *self,
 }
 
 static void
-wb_tweet_row_constructed (GObject *object)
+wb_tweet_row_update_counts (WbTweetRow *self)
 {
-    gchar *created_at;
     gchar *markup;
+    WbTweetRowPrivate *priv = wb_tweet_row_get_instance_private (self);
+
+    markup = g_markup_printf_escaped ("<b>%d</b> Likes",
+                                      priv->tweet_item->attitudes_count);
+    gtk_label_set_markup (GTK_LABEL (priv->likes_label), markup);
+    g_free (markup);
+
+    markup = g_markup_printf_escaped ("<b>%d</b> Comments",
+                                      priv->tweet_item->comments_count);
+    gtk_label_set_markup (GTK_LABEL (priv->comments_label), markup);
+    g_free (markup);
+
+    markup = g_markup_printf_escaped ("<b>%d</b> Reposts",
+                                      priv->tweet_item->reposts_count);
+    gtk_label_set_markup (GTK_LABEL (priv->reposts_label), markup);
+    g_free (markup);
+}
+
+/* The post was fetched again with newer counts. */
+static void
+tweet_item_counts_changed_cb (GObject *object,
+                              GParamSpec *pspec,
+                              gpointer user_data)
+{
+    wb_tweet_row_update_counts (WB_TWEET_ROW (user_data));
+}
+
+static void
+wb_tweet_row_constructed (GObject *object)
+{
     GtkStyleContext *context;
     GtkWidget *hbox1;
     GtkWidget *hbox2;
@@ -133,8 +164,7 @@ wb_tweet_row_constructed (GObject *object)
     {
         /* Profile image (50px by 50px), name, source and time */
         avatar = wb_avatar_widget_new ();
-        wb_avatar_widget_setup (avatar,
-                                priv->tweet_item->user->profile_image_url);
+        wb_avatar_widget_setup (avatar, priv->tweet_item->user);
         priv->profile_image = GTK_WIDGET (avatar);
         gtk_widget_set_halign (priv->profile_image, GTK_ALIGN_START);
         gtk_box_pack_start (GTK_BOX (hbox1), priv->profile_image,
@@ -144,39 +174,27 @@ wb_tweet_row_constructed (GObject *object)
     vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
     gtk_box_pack_start (GTK_BOX (hbox1), vbox, FALSE, FALSE, 0);
 
-    if (g_strcmp0 (priv->tweet_item->user->nickname, "") != 0)
-    {
-        name_button = wb_name_button_new ();
-        wb_name_button_set_text (name_button, priv->tweet_item->user->nickname);
-    }
-    else
-    {
-        name_button = wb_name_button_new ();
-        wb_name_button_set_text (name_button, priv->tweet_item->user->name);
-    }
+    name_button = wb_name_button_new ();
+    wb_name_button_set_user (name_button, priv->tweet_item->user);
     gtk_widget_set_halign (GTK_WIDGET (name_button), GTK_ALIGN_START);
     gtk_widget_set_valign (GTK_WIDGET (name_button), GTK_ALIGN_CENTER);
     gtk_box_pack_start (GTK_BOX (vbox), GTK_WIDGET (name_button), TRUE, TRUE, 0);
 
     if (!priv->retweet && g_strcmp0 (priv->tweet_item->source, "") != 0)
     {
-        gchar *source;
-
         gtk_widget_set_valign (GTK_WIDGET (name_button), GTK_ALIGN_END);
 
-        source = wb_util_format_source_string (priv->tweet_item->source);
-        source_label = gtk_label_new (source);
+        source_label = gtk_label_new (priv->tweet_item->source);
         context = gtk_widget_get_style_context (source_label);
         gtk_style_context_add_class (context, "dim-label");
         gtk_widget_set_halign (source_label, GTK_ALIGN_START);
         gtk_widget_set_valign (source_label, GTK_ALIGN_START);
         gtk_box_pack_end (GTK_BOX (vbox), source_label, TRUE, TRUE, 0);
-
-        g_free (source);
     }
 
-    created_at = wb_util_format_time_string (priv->tweet_item->created_at);
-    time_label = gtk_label_new (created_at);
+    time_label = gtk_label_new (NULL);
+    wb_util_set_time_label (GTK_LABEL (time_label),
+                            priv->tweet_item->created_at);
     context = gtk_widget_get_style_context (time_label);
     gtk_style_context_add_class (context, "dim-label");
     gtk_widget_set_halign (time_label, GTK_ALIGN_END);
@@ -191,11 +209,10 @@ wb_tweet_row_constructed (GObject *object)
 
     /* Post image */
     /* TODO: Add support for display the original picture individually */
-    if (priv->tweet_item->picuri_array->len != 0)
+    if (priv->tweet_item->n_pictures != 0)
     {
         pic_grid = wb_multi_media_widget_new ();
-        wb_multi_media_widget_populate_images (pic_grid,
-                                               priv->tweet_item->picuri_array);
+        wb_multi_media_widget_populate_images (pic_grid, priv->tweet_item);
         gtk_widget_set_halign (GTK_WIDGET (pic_grid), GTK_ALIGN_CENTER);
         gtk_box_pack_start (GTK_BOX (priv->main_box), GTK_WIDGET (pic_grid),
                             FALSE, FALSE, 0);
@@ -211,47 +228,44 @@ wb_tweet_row_constructed (GObject *object)
     {
         GtkStyleContext *context;
         GtkWidget *likes_button;
-        GtkWidget *likes_label;
-        GtkWidget *comments_label;
         GtkWidget *reposts_button;
-        GtkWidget *reposts_label;
 
         likes_button = gtk_button_new ();
         context = gtk_widget_get_style_context (likes_button);
         gtk_style_context_add_class (context, "attitude-buttons");
 
-        likes_label = gtk_label_new (NULL);
-        markup = g_markup_printf_escaped ("<b>%d</b> Likes",
-                                          priv->tweet_item->attitudes_count);
-        gtk_label_set_markup (GTK_LABEL (likes_label), markup);
-        gtk_container_add (GTK_CONTAINER (likes_button), likes_label);
+        priv->likes_label = gtk_label_new (NULL);
+        gtk_container_add (GTK_CONTAINER (likes_button), priv->likes_label);
         gtk_box_pack_start (GTK_BOX (hbox2), likes_button, TRUE, TRUE, 0);
-        g_free (markup);
 
         priv->comment_button = gtk_button_new ();
         context = gtk_widget_get_style_context (priv->comment_button);
         gtk_style_context_add_class (context, "attitude-buttons");
 
-        comments_label = gtk_label_new (NULL);
-        markup = g_markup_printf_escaped ("<b>%d</b> Comments",
-                                          priv->tweet_item->comments_count);
-        gtk_label_set_markup (GTK_LABEL (comments_label), markup);
-        gtk_container_add (GTK_CONTAINER (priv->comment_button), comments_label);
+        priv->comments_label = gtk_label_new (NULL);
+        gtk_container_add (GTK_CONTAINER (priv->comment_button),
+                           priv->comments_label);
         gtk_box_pack_start (GTK_BOX (hbox2), priv->comment_button,
                             TRUE, TRUE, 0);
-        g_free (markup);
 
         reposts_button = gtk_button_new ();
         context = gtk_widget_get_style_context (reposts_button);
         gtk_style_context_add_class (context, "attitude-buttons");
 
-        reposts_label = gtk_label_new (NULL);
-        markup = g_markup_printf_escaped ("<b>%d</b> Reposts",
-                                          priv->tweet_item->reposts_count);
-        gtk_label_set_markup (GTK_LABEL (reposts_label), markup);
-        gtk_container_add (GTK_CONTAINER (reposts_button), reposts_label);
+        priv->reposts_label = gtk_label_new (NULL);
+        gtk_container_add (GTK_CONTAINER (reposts_button), priv->reposts_label);
         gtk_box_pack_start (GTK_BOX (hbox2), reposts_button, TRUE, TRUE, 0);
-        g_free (markup);
+
+        wb_tweet_row_update_counts (row);
+        g_signal_connect_object (priv->tweet_item, "notify::reposts-count",
+                                 G_CALLBACK (tweet_item_counts_changed_cb),
+                                 row, 0);
+        g_signal_connect_object (priv->tweet_item, "notify::comments-count",
+                                 G_CALLBACK (tweet_item_counts_changed_cb),
+                                 row, 0);
+        g_signal_connect_object (priv->tweet_item, "notify::attitudes-count",
+                                 G_CALLBACK (tweet_item_counts_changed_cb),
+                                 row, 0);
 
         gtk_box_pack_start (GTK_BOX (priv->main_box), hbox2, FALSE, FALSE, 0);
     }
@@ -259,8 +273,6 @@ wb_tweet_row_constructed (GObject *object)
     gtk_container_add (GTK_CONTAINER (row), priv->main_box);
     gtk_widget_show_all (GTK_WIDGET (row));
 
-    g_free (created_at);
-
     G_OBJECT_CLASS (wb_tweet_row_parent_class)->constructed (object);
 }
 
@@ -355,8 +367,7 @@ wb_tweet_row_init (WbTweetRow *self)
 
     priv = wb_tweet_row_get_instance_private (self);
 
-    priv->profile_image = gtk_image_new_from_pixbuf (NULL);
-    priv->post_image = gtk_image_new_from_pixbuf (NULL);
+    priv->profile_image = NULL;
 
     priv->main_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
     gtk_widget_set_margin_start (priv->main_box, 12);
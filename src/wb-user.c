@@ -20,8 +20,18 @@
 
 #include "wb-user.h"
 
+enum
+{
+    PROP_0,
+    PROP_NAME,
+    PROP_NICKNAME,
+    N_PROPERTIES
+};
+
 G_DEFINE_TYPE (WbUser, wb_user, G_TYPE_OBJECT)
 
+static GParamSpec *obj_properties[N_PROPERTIES] = { NULL, };
+
 static void
 wb_user_parse_json_object (WbUser *self,
                            JsonObject *jobject)
@@ -33,6 +43,16 @@ wb_user_parse_json_object (WbUser *self,
     self->location = g_strdup (json_object_get_string_member (jobject, "location"));
     self->profile_image_url = g_strdup (json_object_get_string_member (jobject,
                                                                        "profile_image_url"));
+    if (json_object_has_member (jobject, "avatar_large"))
+    {
+        self->avatar_large = g_strdup (json_object_get_string_member (jobject,
+                                                                      "avatar_large"));
+    }
+    if (json_object_has_member (jobject, "avatar_hd"))
+    {
+        self->avatar_hd = g_strdup (json_object_get_string_member (jobject,
+                                                                   "avatar_hd"));
+    }
 }
 
 static void
@@ -47,18 +67,59 @@ wb_user_finalize (GObject *object)
     g_free (self->description);
     g_free (self->url);
     g_free (self->profile_image_url);
+    g_free (self->avatar_large);
+    g_free (self->avatar_hd);
     g_free (self->gender);
     g_free (self->created_at);
 
     G_OBJECT_CLASS (wb_user_parent_class)->finalize (object);
 }
 
+static void
+wb_user_get_property (GObject *object,
+                      guint prop_id,
+                      GValue *value,
+                      GParamSpec *pspec)
+{
+    WbUser *self = WB_USER (object);
+
+    switch (prop_id)
+    {
+        case PROP_NAME:
+            g_value_set_string (value, self->name);
+            break;
+        case PROP_NICKNAME:
+            g_value_set_string (value, self->nickname);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+}
+
 static void
 wb_user_class_init (WbUserClass *klass)
 {
 		GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
 		object_class->finalize = wb_user_finalize;
+		object_class->get_property = wb_user_get_property;
+
+    obj_properties[PROP_NAME] = g_param_spec_string ("name",
+                                                     "Name",
+                                                     "Screen name of the user",
+                                                     NULL,
+                                                     G_PARAM_READABLE |
+                                                     G_PARAM_STATIC_STRINGS);
+    obj_properties[PROP_NICKNAME] = g_param_spec_string ("nickname",
+                                                         "Nickname",
+                                                         "Name given to the user by the logged in user",
+                                                         NULL,
+                                                         G_PARAM_READABLE |
+                                                         G_PARAM_STATIC_STRINGS);
+
+    g_object_class_install_properties (object_class, N_PROPERTIES,
+                                       obj_properties);
 }
 
 static void
@@ -66,6 +127,114 @@ wb_user_init (WbUser *self)
 {
 }
 
+/**
+ * wb_user_get_avatar_url:
+ * @self: a #WbUser
+ * @size: the size of the avatar in device pixels
+ *
+ * Pick the smallest avatar which is at least @size pixels wide, so
+ * that it stays sharp on HiDPI screens without downloading more than
+ * needed.
+ *
+ * Returns: (transfer none): the uri of the avatar
+ */
+const gchar *
+wb_user_get_avatar_url (WbUser *self,
+                        gint size)
+{
+    if (size > 180 && self->avatar_hd != NULL)
+    {
+        return self->avatar_hd;
+    }
+    else if (size > 50 && self->avatar_large != NULL)
+    {
+        return self->avatar_large;
+    }
+    else
+    {
+        return self->profile_image_url;
+    }
+}
+
+/**
+ * wb_user_get_display_name:
+ * @self: a #WbUser
+ *
+ * Returns: (transfer none): the nickname of the user if there is one,
+ * the screen name otherwise
+ */
+const gchar *
+wb_user_get_display_name (WbUser *self)
+{
+    g_return_val_if_fail (WB_IS_USER (self), NULL);
+
+    if (self->nickname != NULL && self->nickname[0] != '\0')
+    {
+        return self->nickname;
+    }
+
+    return self->name;
+}
+
+static void
+wb_user_update_string (WbUser *self,
+                       gchar **field,
+                       const gchar *value,
+                       GParamSpec *pspec)
+{
+    if (g_strcmp0 (*field, value) == 0)
+    {
+        return;
+    }
+
+    g_free (*field);
+    *field = g_strdup (value);
+
+    if (pspec != NULL)
+    {
+        g_object_notify_by_pspec (G_OBJECT (self), pspec);
+    }
+}
+
+/**
+ * wb_user_update:
+ * @self: a #WbUser
+ * @newer: the same user, fetched again
+ *
+ * Take the names and the avatars of @newer, notifying the names which
+ * changed.
+ */
+void
+wb_user_update (WbUser *self,
+                WbUser *newer)
+{
+    g_return_if_fail (WB_IS_USER (self));
+    g_return_if_fail (WB_IS_USER (newer));
+
+    g_object_freeze_notify (G_OBJECT (self));
+
+    wb_user_update_string (self, &self->name, newer->name,
+                           obj_properties[PROP_NAME]);
+    wb_user_update_string (self, &self->nickname, newer->nickname,
+                           obj_properties[PROP_NICKNAME]);
+    wb_user_update_string (self, &self->location, newer->location, NULL);
+    wb_user_update_string (self, &self->profile_image_url,
+                           newer->profile_image_url, NULL);
+    /* Only some replies have the larger avatars. */
+    if (newer->avatar_large != NULL)
+    {
+        wb_user_update_string (self, &self->avatar_large,
+                               newer->avatar_large, NULL);
+    }
+    if (newer->avatar_hd != NULL)
+    {
+        wb_user_update_string (self, &self->avatar_hd, newer->avatar_hd,
+                               NULL);
+    }
+
+    g_object_thaw_notify (G_OBJECT (self));
+}
+
 /**
  * wb_user_new:
  *
@@ -34,7 +34,10 @@ struct _WbUser
     gchar *location;
     gchar *description;
     gchar *url;
+    /* 50*50, 180*180 and the original size of the avatar. */
     gchar *profile_image_url;
+    gchar *avatar_large;
+    gchar *avatar_hd;
     gchar *gender;
     gint followers_count;
     gint friends_count;
@@ -49,6 +52,9 @@ struct _WbUser
 
 G_DECLARE_FINAL_TYPE (WbUser, wb_user, WB, USER, GObject)
 
+const gchar *wb_user_get_avatar_url (WbUser *self, gint size);
+const gchar *wb_user_get_display_name (WbUser *self);
+void wb_user_update (WbUser *self, WbUser *newer);
 WbUser *wb_user_new (JsonObject *jobject);
 
 G_END_DECLS
@@ -19,6 +19,9 @@
 #include <glib.h>
 #include <json-glib/json-glib.h>
 #include <libsoup/soup.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 #include "wb-timeline-list.h"
 #include "wb-util.h"
@@ -27,149 +30,335 @@ static const gchar SETTINGS_SCHEMA[] = "com.jonathankang.Weibird";
 static const gchar ACCESS_TOKEN[] = "access-token";
 static const gchar APP_KEY[] = "app-key";
 static const gchar APP_SECRET[] = "app-secret";
+static const gchar DISK_CACHE_SIZE[] = "disk-cache-size";
 
 void
 wb_util_init_soup_session (void)
 {
-    SOUPSESSION = soup_session_new ();
+    g_autofree gchar *cache_dir = NULL;
+    guint cache_size;
+    GSettings *settings;
+    SoupCache *cache;
+
+    /* WbImageLoader keeps the number of concurrent image downloads
+     * within these limits, the defaults would serialize them. */
+    SOUPSESSION = soup_session_new_with_options (SOUP_SESSION_MAX_CONNS, 16,
+                                                 SOUP_SESSION_MAX_CONNS_PER_HOST, 10,
+                                                 NULL);
+
+    settings = g_settings_new (SETTINGS_SCHEMA);
+    cache_size = g_settings_get_uint (settings, DISK_CACHE_SIZE);
+    g_object_unref (settings);
+
+    if (cache_size == 0)
+    {
+        return;
+    }
+
+    /* Keep avatars and post images on disk across sessions. SoupCache
+     * drops the least recently used entries once it grows beyond the
+     * maximum size, and revalidates stale entries using the ETag and
+     * Last-Modified headers. */
+    cache_dir = g_build_filename (g_get_user_cache_dir (), "weibird",
+                                  "http", NULL);
+    cache = soup_cache_new (cache_dir, SOUP_CACHE_SINGLE_USER);
+    soup_cache_set_max_size (cache, MIN (cache_size, G_MAXUINT / (1024 * 1024))
+                                    * 1024 * 1024);
+    soup_cache_load (cache);
+
+    soup_session_add_feature (SOUPSESSION, SOUP_SESSION_FEATURE (cache));
+
+    g_object_unref (cache);
 }
 
 void
 wb_util_finalize_soup_session (void)
 {
+    SoupSessionFeature *cache;
+
+    if (SOUPSESSION == NULL)
+    {
+        return;
+    }
+
+    /* Write the cache index to disk, so that it can be reused
+     * next time. */
+    cache = soup_session_get_feature (SOUPSESSION, SOUP_TYPE_CACHE);
+    if (cache != NULL)
+    {
+        soup_cache_flush (SOUP_CACHE (cache));
+        soup_cache_dump (SOUP_CACHE (cache));
+    }
+
     g_clear_object (&SOUPSESSION);
 }
 
 /**
- * wb_util_format_time_string:
+ * wb_util_parse_time_string:
  * @time: the time string fetched from Weibo API
  *
- * This function parses the time string fetched from Weibo
- * API(for instance, Wed Mar 06 14:00:58 +0800 2019) and
- * return a meaningful time.
+ * Parse a time string fetched from Weibo API, for instance
+ * "Wed Mar 06 14:00:58 +0800 2019", without allocating anything.
  *
- * Returns: A newly allocated string
+ * Returns: the time as Unix time, or 0 if @time can't be parsed
  */
-gchar *
-wb_util_format_time_string (const gchar *time)
+gint64
+wb_util_parse_time_string (const gchar *time)
 {
-    const gchar *month_str[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
-                                "July", "Aug", "Sep", "Oct", "Nov", "Dec"};
-    gchar *ret;
-    gchar *year;
-    gchar *day;
-    gchar * hour;
-    gchar *minute;
-    gboolean same_year;
-    gboolean same_month;
-    gboolean same_day;
-    gboolean same_hour;
-    gboolean same_minute;
-    gchar **vector;
-    GDateTime *now;
-
-    g_return_val_if_fail (time != NULL, NULL);
-
-    now = g_date_time_new_now_local ();
-    vector = g_strsplit_set (time, " :", -1);
-    year = g_strdup_printf ("%d", g_date_time_get_year (now));
-    if (g_date_time_get_day_of_month (now) < 10)
-    {
-        /* Prefix "0" if it's smaller than 10. */
-        day = g_strdup_printf ("0%d", g_date_time_get_day_of_month (now));
+    static const gchar months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    gint year;
+    gint month;
+    gint day;
+    gint hour;
+    gint minute;
+    gint second;
+    gint offset;
+    gint64 days;
+    gint64 era;
+    gint64 year_of_era;
+    gint64 day_of_year;
+
+    if (time == NULL || strlen (time) < 30)
+    {
+        return 0;
     }
-    else
+
+    for (month = 0; month < 12; month++)
+    {
+        if (strncmp (time + 4, months + month * 3, 3) == 0)
+        {
+            break;
+        }
+    }
+    if (month == 12)
     {
-        day = g_strdup_printf ("%d", g_date_time_get_day_of_month (now));
+        return 0;
     }
+    month++;
 
-    if (g_date_time_get_hour (now) < 10)
+    if (sscanf (time + 8, "%2d %2d:%2d:%2d %5d %4d",
+                &day, &hour, &minute, &second, &offset, &year) != 6)
     {
-        hour = g_strdup_printf ("0%d", g_date_time_get_hour (now));
+        return 0;
     }
-    else
+
+    /* Days since 1970-01-01 in the proleptic Gregorian calendar, with
+     * years starting in March so that leap days come last. */
+    if (month <= 2)
     {
-        hour = g_strdup_printf ("%d", g_date_time_get_hour (now));
+        year--;
     }
+    era = year / 400;
+    year_of_era = year - era * 400;
+    day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    days = era * 146097 + year_of_era * 365 + year_of_era / 4
+           - year_of_era / 100 + day_of_year - 719468;
+
+    /* The offset is written as ±hhmm. */
+    return days * 86400 + hour * 3600 + minute * 60 + second
+           - ((offset / 100) * 3600 + (offset % 100) * 60);
+}
 
-    if (g_date_time_get_minute (now) < 10)
+/**
+ * wb_util_format_time:
+ * @time: Unix time
+ * @now: the current Unix time
+ * @buffer: (out caller-allocates): where to write the description
+ * @size: size of @buffer in bytes
+ *
+ * Describe @time relative to @now, in the local time zone. Nothing is
+ * allocated, so that this can be called for every shown time label
+ * each minute.
+ */
+void
+wb_util_format_time (gint64 time,
+                     gint64 now,
+                     gchar *buffer,
+                     gsize size)
+{
+    static const gchar *months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                     "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    gint64 minutes;
+    time_t time_t_time;
+    time_t time_t_now;
+    struct tm tm_time;
+    struct tm tm_now;
+
+    g_return_if_fail (buffer != NULL && size > 0);
+
+    /* Count minute boundaries rather than seconds, so that the text
+     * only changes when the shared timer fires. */
+    minutes = now / 60 - time / 60;
+    if (minutes <= 0)
     {
-        minute = g_strdup_printf ("0%d", g_date_time_get_minute (now));
+        g_strlcpy (buffer, "Just Now", size);
+        return;
     }
-    else
+    else if (minutes < 60)
     {
-        minute = g_strdup_printf ("%d", g_date_time_get_minute (now));
+        g_snprintf (buffer, size, "%d minutes ago", (gint) minutes);
+        return;
     }
 
-    same_year = !g_strcmp0 (year, vector[7]);
-    same_month = !g_strcmp0 (month_str[g_date_time_get_month (now) - 1], vector[1]);
-    same_day = !g_strcmp0 (day, vector[2]);
-    same_hour = !g_strcmp0 (hour, vector[3]);
-    same_minute = !g_strcmp0 (minute, vector[4]);
+    time_t_time = (time_t) time;
+    time_t_now = (time_t) now;
+    if (localtime_r (&time_t_time, &tm_time) == NULL ||
+        localtime_r (&time_t_now, &tm_now) == NULL)
+    {
+        buffer[0] = '\0';
+        return;
+    }
 
-    if (same_year && same_month && same_day && same_hour && same_minute)
+    if (tm_time.tm_year != tm_now.tm_year)
     {
-        ret = g_strdup_printf ("Just Now");
+        g_snprintf (buffer, size, "%02d:%02d %s %02d %d",
+                    tm_time.tm_hour, tm_time.tm_min, months[tm_time.tm_mon],
+                    tm_time.tm_mday, tm_time.tm_year + 1900);
     }
-    else if (same_year && same_month && same_day && same_hour)
+    else if (tm_time.tm_yday != tm_now.tm_yday)
     {
-        ret = g_strdup_printf ("%d minutes ago",
-                               g_date_time_get_minute (now) - atoi (vector[4]));
+        g_snprintf (buffer, size, "%02d:%02d %s %02d",
+                    tm_time.tm_hour, tm_time.tm_min, months[tm_time.tm_mon],
+                    tm_time.tm_mday);
     }
-    else if (same_year && same_month && same_day)
+    else
     {
-        ret = g_strdup_printf ("%s:%s", vector[3], vector[4]);
+        g_snprintf (buffer, size, "%02d:%02d",
+                    tm_time.tm_hour, tm_time.tm_min);
     }
-    else if ((same_year && same_month)
-             || (same_year && !same_month))
+}
+
+/* GtkLabel → Unix time it shows, for every time label alive. */
+static GHashTable *time_labels = NULL;
+static guint time_labels_timeout_id = 0;
+
+static void
+wb_util_update_time_label (GtkLabel *label,
+                           gint64 time,
+                           gint64 now)
+{
+    gchar buffer[64];
+
+    wb_util_format_time (time, now, buffer, sizeof (buffer));
+
+    /* Setting the same text would still queue a resize. */
+    if (strcmp (gtk_label_get_text (label), buffer) != 0)
     {
-        ret = g_strdup_printf ("%s:%s %s %s",
-                               vector[3], vector[4], vector[1], vector[2]);
+        gtk_label_set_text (label, buffer);
     }
-    else
+}
+
+static gboolean time_labels_timeout_cb (gpointer user_data);
+
+static void
+wb_util_schedule_time_labels (void)
+{
+    guint delay;
+
+    /* Aim just past the next minute boundary each time, a fixed
+     * interval would drift away from it. */
+    delay = 60000 - (g_get_real_time () / 1000) % 60000 + 50;
+    time_labels_timeout_id = g_timeout_add (delay, time_labels_timeout_cb,
+                                            NULL);
+}
+
+static gboolean
+time_labels_timeout_cb (gpointer user_data)
+{
+    gint64 now;
+    gint64 *time;
+    GHashTableIter iter;
+    gpointer label;
+
+    now = g_get_real_time () / G_USEC_PER_SEC;
+
+    /* Labels which are not mapped are brought up to date in
+     * time_label_map_cb() once they are shown again. */
+    g_hash_table_iter_init (&iter, time_labels);
+    while (g_hash_table_iter_next (&iter, &label, (gpointer *) &time))
     {
-        ret = g_strdup_printf ("%s:%s %s %s %s",
-                               vector[3], vector[4], vector[1], vector[2], vector[7]);
+        if (gtk_widget_get_mapped (GTK_WIDGET (label)))
+        {
+            wb_util_update_time_label (GTK_LABEL (label), *time, now);
+        }
     }
 
-    g_date_time_unref (now);
-    g_free (year);
-    g_free (day);
-    g_free (hour);
-    g_free (minute);
-    g_strfreev (vector);
+    time_labels_timeout_id = 0;
+    wb_util_schedule_time_labels ();
 
-    return ret;
+    return G_SOURCE_REMOVE;
+}
+
+static void
+time_label_map_cb (GtkWidget *label,
+                   gpointer user_data)
+{
+    gint64 *time;
+
+    time = g_hash_table_lookup (time_labels, label);
+    if (time != NULL)
+    {
+        wb_util_update_time_label (GTK_LABEL (label), *time,
+                                   g_get_real_time () / G_USEC_PER_SEC);
+    }
+}
+
+static void
+time_label_destroy_cb (GtkWidget *label,
+                       gpointer user_data)
+{
+    g_hash_table_remove (time_labels, label);
+
+    if (g_hash_table_size (time_labels) == 0 && time_labels_timeout_id != 0)
+    {
+        g_source_remove (time_labels_timeout_id);
+        time_labels_timeout_id = 0;
+    }
 }
 
 /**
- * wb_util_format_source_string:
- * @source: the source string fetched from Weibo API
+ * wb_util_set_time_label:
+ * @label: a #GtkLabel
+ * @time: Unix time
  *
- * This function parses a <a> tag and returns the text.
- *
- * Returns: A newly allocated string
+ * Show @time relative to now in @label, and keep it correct as time
+ * goes by. A single timer, firing on minute boundaries, updates the
+ * labels which are mapped at that time; the others are updated when
+ * they get mapped.
  */
-gchar *
-wb_util_format_source_string (const gchar *source)
+void
+wb_util_set_time_label (GtkLabel *label,
+                        gint64 time)
 {
-    gchar **vector;
-    gchar *ret;
+    gint64 *stored;
 
-    g_return_val_if_fail (source != NULL, NULL);
+    g_return_if_fail (GTK_IS_LABEL (label));
 
-    /* Don't parse it when @source is an empty string */
-    if (g_strcmp0 (source, "") == 0)
+    if (time_labels == NULL)
     {
-        return NULL;
+        time_labels = g_hash_table_new_full (NULL, NULL, NULL, g_free);
     }
 
-    vector = g_strsplit_set (source, "<>", -1);
-    ret = g_strdup (vector[2]);
+    stored = g_hash_table_lookup (time_labels, label);
+    if (stored == NULL)
+    {
+        stored = g_new (gint64, 1);
+        g_hash_table_insert (time_labels, label, stored);
 
-    g_strfreev (vector);
+        g_signal_connect (label, "map",
+                          G_CALLBACK (time_label_map_cb), NULL);
+        g_signal_connect (label, "destroy",
+                          G_CALLBACK (time_label_destroy_cb), NULL);
+    }
+    *stored = time;
 
-    return ret;
+    wb_util_update_time_label (label, time,
+                               g_get_real_time () / G_USEC_PER_SEC);
+
+    if (time_labels_timeout_id == 0)
+    {
+        wb_util_schedule_time_labels ();
+    }
 }
 
 /**
@@ -224,41 +413,214 @@ wb_util_thumbnail_to_original (const gchar *thumbnail)
     return ret;
 }
 
-GtkWidget *
-wb_util_scale_image (GdkPixbuf *pixbuf,
-                     gint *width,
-                     gint *height)
+/**
+ * wb_util_get_vadjustment:
+ * @widget: a #GtkWidget
+ *
+ * Find the vertical adjustment of the #GtkScrolledWindow
+ * that @widget is placed in.
+ *
+ * Returns: (transfer none) (nullable): a #GtkAdjustment, or %NULL
+ * if @widget is not inside a #GtkScrolledWindow
+ */
+GtkAdjustment *
+wb_util_get_vadjustment (GtkWidget *widget)
 {
-    GtkWidget *image;
+    GtkWidget *scrolled;
 
-    if (*width > MAX_WIDTH && *height > MAX_HEIGHT)
+    scrolled = gtk_widget_get_ancestor (widget, GTK_TYPE_SCROLLED_WINDOW);
+    if (scrolled == NULL)
     {
-        gdouble scale;
-        GdkPixbuf *scaled_pixbuf;
+        return NULL;
+    }
 
-        scale = (gdouble) MAX_WIDTH / *width;
-        if (*height * scale > MAX_HEIGHT)
-        {
-            scale = (gdouble) MAX_HEIGHT / *height;
-        }
+    return gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (scrolled));
+}
+
+/**
+ * wb_util_get_viewport_position:
+ * @widget: a #GtkWidget
+ *
+ * Check whether @widget is shown in the visible area of the
+ * #GtkScrolledWindow it is placed in, or within one page above or
+ * below it. A widget which is not inside a #GtkScrolledWindow is
+ * always considered to be visible.
+ *
+ * Returns: a #WbViewportPosition
+ */
+WbViewportPosition
+wb_util_get_viewport_position (GtkWidget *widget)
+{
+    gdouble page_size;
+    gdouble value;
+    gint height;
+    gint x, y;
+    GtkAdjustment *vadjustment;
+    GtkWidget *child;
+    GtkWidget *scrolled;
+
+    scrolled = gtk_widget_get_ancestor (widget, GTK_TYPE_SCROLLED_WINDOW);
+    if (scrolled == NULL)
+    {
+        return WB_VIEWPORT_VISIBLE;
+    }
+
+    child = gtk_bin_get_child (GTK_BIN (scrolled));
+    if (GTK_IS_VIEWPORT (child))
+    {
+        child = gtk_bin_get_child (GTK_BIN (child));
+    }
 
-        scaled_pixbuf = gdk_pixbuf_scale_simple (pixbuf,
-                                                 *width * scale,
-                                                 *height * scale,
-                                                 GDK_INTERP_BILINEAR);
-        *width *= scale;
-        *height *= scale;
+    /* Not allocated yet, we don't know where it is. */
+    if (child == NULL ||
+        !gtk_widget_translate_coordinates (widget, child, 0, 0, &x, &y))
+    {
+        return WB_VIEWPORT_FAR;
+    }
 
-        image = gtk_image_new_from_pixbuf (scaled_pixbuf);
+    vadjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (scrolled));
+    value = gtk_adjustment_get_value (vadjustment);
+    page_size = gtk_adjustment_get_page_size (vadjustment);
+    height = gtk_widget_get_allocated_height (widget);
 
-        g_object_unref (scaled_pixbuf);
+    if (y + height >= value && y <= value + page_size)
+    {
+        return WB_VIEWPORT_VISIBLE;
     }
-    else
+    else if (y + height >= value - page_size && y <= value + 2 * page_size)
+    {
+        return WB_VIEWPORT_NEAR;
+    }
+
+    return WB_VIEWPORT_FAR;
+}
+
+/**
+ * wb_util_track_viewport:
+ * @image: a #WbLazyImage
+ * @widget: the #GtkWidget showing @image
+ * @maybe_load: called with @widget whenever its #GtkScrolledWindow
+ * scrolls
+ *
+ * Follow the position of @widget in the #GtkScrolledWindow it is
+ * placed in, until wb_util_untrack_viewport() is called.
+ */
+void
+wb_util_track_viewport (WbLazyImage *image,
+                        GtkWidget *widget,
+                        GCallback maybe_load)
+{
+    wb_util_untrack_viewport (image);
+
+    image->vadjustment = wb_util_get_vadjustment (widget);
+    if (image->vadjustment != NULL)
+    {
+        g_object_ref (image->vadjustment);
+        image->value_changed_id = g_signal_connect_swapped (image->vadjustment,
+                                                            "value-changed",
+                                                            maybe_load,
+                                                            widget);
+    }
+}
+
+/**
+ * wb_util_untrack_viewport:
+ * @image: a #WbLazyImage
+ *
+ * Stop following the position of the widget showing @image.
+ */
+void
+wb_util_untrack_viewport (WbLazyImage *image)
+{
+    if (image->vadjustment != NULL)
+    {
+        g_signal_handler_disconnect (image->vadjustment,
+                                     image->value_changed_id);
+        image->value_changed_id = 0;
+        g_clear_object (&image->vadjustment);
+    }
+}
+
+/**
+ * wb_util_queue_image:
+ * @image: a #WbLazyImage
+ * @widget: the #GtkWidget showing @image
+ * @loader: the #WbImageLoader @image is loaded with
+ * @visible_priority: the priority of @image while @widget is visible
+ *
+ * Pick the priority of @image according to the position of @widget.
+ * An image which is queued already is moved ahead once it is shown.
+ *
+ * Returns: %TRUE if @image should be loaded now, using the cancellable
+ * and priority of @image
+ */
+gboolean
+wb_util_queue_image (WbLazyImage *image,
+                     GtkWidget *widget,
+                     WbImageLoader *loader,
+                     WbImagePriority visible_priority)
+{
+    WbImagePriority priority;
+    WbViewportPosition position;
+
+    position = wb_util_get_viewport_position (widget);
+    priority = position == WB_VIEWPORT_VISIBLE ? visible_priority
+                                               : WB_IMAGE_PRIORITY_PREFETCH;
+
+    if (image->cancellable != NULL)
+    {
+        if (image->priority != priority)
+        {
+            image->priority = priority;
+            wb_image_loader_set_priority (loader, image->cancellable, priority);
+        }
+
+        return FALSE;
+    }
+
+    /* Only download the image when it is about to be shown. */
+    if (position == WB_VIEWPORT_FAR)
     {
-        image = gtk_image_new_from_pixbuf (pixbuf);
+        return FALSE;
     }
 
-    return image;
+    image->cancellable = g_cancellable_new ();
+    image->priority = priority;
+
+    return TRUE;
+}
+
+/**
+ * wb_util_image_loaded:
+ * @image: a #WbLazyImage
+ *
+ * Forget the request of @image once it is done, its widget doesn't
+ * need to be followed anymore.
+ */
+void
+wb_util_image_loaded (WbLazyImage *image)
+{
+    g_clear_object (&image->cancellable);
+    wb_util_untrack_viewport (image);
+}
+
+/**
+ * wb_util_cancel_image:
+ * @image: a #WbLazyImage
+ *
+ * Cancel loading @image, if it is queued, and stop following the
+ * position of its widget.
+ */
+void
+wb_util_cancel_image (WbLazyImage *image)
+{
+    wb_util_untrack_viewport (image);
+
+    if (image->cancellable != NULL)
+    {
+        g_cancellable_cancel (image->cancellable);
+        g_clear_object (&image->cancellable);
+    }
 }
 
 gchar *
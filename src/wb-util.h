@@ -23,6 +23,7 @@
 #include <json-glib/json-glib.h>
 #include <libsoup/soup.h>
 
+#include "wb-image-loader.h"
 #include "wb-timeline-list.h"
 
 G_BEGIN_DECLS
@@ -30,15 +31,48 @@ G_BEGIN_DECLS
 #define MAX_WIDTH 1000
 #define MAX_HEIGHT 800
 
+typedef enum
+{
+    WB_VIEWPORT_VISIBLE,
+    WB_VIEWPORT_NEAR,
+    WB_VIEWPORT_FAR
+} WbViewportPosition;
+
+/* The image of a widget, downloaded once the widget gets near the
+ * visible area of its #GtkScrolledWindow. */
+typedef struct
+{
+    GtkAdjustment *vadjustment;
+    gulong value_changed_id;
+    GCancellable *cancellable;
+    WbImagePriority priority;
+} WbLazyImage;
+
 SoupSession *SOUPSESSION;
 
 void wb_util_init_soup_session (void);
 void wb_util_finalize_soup_session (void);
-gchar *wb_util_format_time_string (const gchar *time);
-gchar *wb_util_format_source_string (const gchar *source);
+gint64 wb_util_parse_time_string (const gchar *time);
+void wb_util_format_time (gint64 time,
+                          gint64 now,
+                          gchar *buffer,
+                          gsize size);
+void wb_util_set_time_label (GtkLabel *label,
+                             gint64 time);
 gchar *wb_util_thumbnail_to_middle (const gchar *thumbnail);
 gchar *wb_util_thumbnail_to_original (const gchar *thumbnail);
-GtkWidget *wb_util_scale_image (GdkPixbuf *pixbuf, gint *width, gint *height);
+GtkAdjustment *wb_util_get_vadjustment (GtkWidget *widget);
+WbViewportPosition wb_util_get_viewport_position (GtkWidget *widget);
+void wb_util_track_viewport (WbLazyImage *image,
+                             GtkWidget *widget,
+                             GCallback maybe_load);
+void wb_util_untrack_viewport (WbLazyImage *image);
+gboolean wb_util_queue_image (WbLazyImage *image,
+                              GtkWidget *widget,
+                              WbImageLoader *loader,
+                              WbImagePriority visible_priority);
+void wb_util_image_loaded (WbLazyImage *image);
+void wb_util_cancel_image (WbLazyImage *image);
 gchar *wb_util_get_access_token (void);
 gchar *wb_util_get_app_key (void);
 gchar *wb_util_get_app_secret (void);
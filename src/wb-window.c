@@ -119,9 +119,24 @@ on_view_mode (GSimpleAction *action,
     g_type_class_unref (eclass);
 }
 
+static void
+on_refresh (GSimpleAction *action,
+            GVariant *variant,
+            gpointer user_data)
+{
+    GtkWidget *timeline;
+    WbWindowPrivate *priv;
+
+    priv = wb_window_get_instance_private (WB_WINDOW (user_data));
+    timeline = wb_main_widget_get_timeline (WB_MAIN_WIDGET (priv->main_widget));
+
+    wb_timeline_list_refresh (WB_TIMELINE_LIST (timeline));
+}
+
 static GActionEntry actions[] = {
     { "headerbar-mode", on_action_radio, "s", "'list'", on_headerbar_mode },
-    { "view-mode", on_view_mode, "s", "'list'", on_view_mode }
+    { "view-mode", on_view_mode, "s", "'list'", on_view_mode },
+    { "refresh", on_refresh }
 };
 
 static void